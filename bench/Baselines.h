@@ -0,0 +1,143 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Workloads.h"
+
+#include <boost/pool/pool_alloc.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define BENCH_HAS_PMR 1
+#endif
+#endif
+
+#ifndef BENCH_HAS_PMR
+#define BENCH_HAS_PMR 0
+#endif
+
+// Baseline configs for the workloads: other pool allocators with full-size pointers.
+// They separate the allocation speed benefit of Arena from the cache benefit of small Pointer.
+
+namespace bench {
+
+/**
+* @brief Bump allocator over a list of chunks, deallocation does nothing, memory is freed at once
+*/
+class BumpArena {
+public:
+    static constexpr size_t kChunkSize = 1 << 20;
+
+    BumpArena() = default;
+    BumpArena(const BumpArena&) = delete;
+    BumpArena& operator=(const BumpArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment) {
+        uintptr_t pos = (m_pos + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (pos + bytes > m_end) {
+            size_t size = std::max(kChunkSize, bytes + alignment);
+            m_chunks.emplace_back(new char[size]);
+            m_pos = reinterpret_cast<uintptr_t>(m_chunks.back().get());
+            m_end = m_pos + size;
+            pos = (m_pos + alignment - 1) & ~uintptr_t(alignment - 1);
+        }
+        m_pos = pos + bytes;
+        return reinterpret_cast<void*>(pos);
+    }
+
+    // Arena used by BumpAllocator
+    static BumpArena*& current() {
+        static BumpArena* arena = nullptr;
+        return arena;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    uintptr_t m_pos = 0;
+    uintptr_t m_end = 0;
+};
+
+template <typename Type>
+class BumpAllocator {
+public:
+    using value_type = Type;
+
+    BumpAllocator() = default;
+
+    template <typename Type2>
+    BumpAllocator(const BumpAllocator<Type2>&) noexcept {}
+
+    Type* allocate(size_t n) {
+        return static_cast<Type*>(BumpArena::current()->allocate(n * sizeof(Type), alignof(Type)));
+    }
+
+    void deallocate(Type*, size_t) noexcept {}
+};
+
+template <typename Type1, typename Type2>
+bool operator==(const BumpAllocator<Type1>&, const BumpAllocator<Type2>&) noexcept { return true; }
+
+template <typename Type1, typename Type2>
+bool operator!=(const BumpAllocator<Type1>&, const BumpAllocator<Type2>&) noexcept { return false; }
+
+struct BumpConfig : public StdConfig {
+    template <typename Type>
+    using Alloc = BumpAllocator<Type>;
+
+    struct Resource {
+        explicit Resource(size_t) { BumpArena::current() = &arena; }
+
+        ~Resource() { BumpArena::current() = nullptr; }
+
+        BumpArena arena;
+    };
+};
+
+struct BoostPoolConfig : public StdConfig {
+    template <typename Type>
+    using Alloc = boost::pool_allocator<Type>;
+};
+
+struct BoostFastPoolConfig : public StdConfig {
+    template <typename Type>
+    using Alloc = boost::fast_pool_allocator<Type>;
+};
+
+#if BENCH_HAS_PMR == 1
+
+/**
+* @brief polymorphic_allocator over MemoryResource installed as the default resource for ArenaScope
+*/
+template <typename MemoryResource>
+struct PmrConfig : public StdConfig {
+    template <typename Type>
+    using Alloc = std::pmr::polymorphic_allocator<Type>;
+
+    struct Resource {
+        explicit Resource(size_t)
+        : prev(std::pmr::set_default_resource(&resource)) {}
+
+        ~Resource() { std::pmr::set_default_resource(prev); }
+
+        MemoryResource resource;
+        std::pmr::memory_resource* prev;
+    };
+};
+
+struct PmrPoolConfig : public PmrConfig<std::pmr::unsynchronized_pool_resource> {};
+struct PmrSyncPoolConfig : public PmrConfig<std::pmr::synchronized_pool_resource> {};
+
+#endif
+
+}
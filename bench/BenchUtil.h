@@ -0,0 +1,397 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/**
+* @brief Command line options in the form --name=value1,value2 or --flag
+*/
+class Options {
+public:
+    Options(int argc, char* argv[]) {
+        for (int i = 0; i < argc; ++i) {
+            std::string arg(argv[i]);
+            if (arg.compare(0, 2, "--") != 0) {
+                throw std::invalid_argument("unexpected argument " + arg);
+            }
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                m_values[arg.substr(2)] = "1";
+            } else {
+                m_values[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        }
+    }
+
+    bool has(const std::string& name) const { return m_values.count(name) != 0; }
+
+    std::string str(const std::string& name, const std::string& defValue) const {
+        auto it = m_values.find(name);
+        return (it != m_values.end()) ? it->second : defValue;
+    }
+
+    size_t num(const std::string& name, size_t defValue) const {
+        return has(name) ? std::stoul(str(name, "")) : defValue;
+    }
+
+    std::vector<std::string> list(const std::string& name, const std::string& defValue) const {
+        std::vector<std::string> res;
+        std::istringstream stream(str(name, defValue));
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            if (!item.empty()) {
+                res.push_back(item);
+            }
+        }
+        return res;
+    }
+
+    std::vector<size_t> numList(const std::string& name, const std::string& defValue) const {
+        std::vector<size_t> res;
+        for (const std::string& item : list(name, defValue)) {
+            res.push_back(std::stoul(item));
+        }
+        return res;
+    }
+
+private:
+    std::map<std::string, std::string> m_values;
+};
+
+/**
+* @brief Output stream given by --out=file option, std::cout if the option is missing
+*/
+class Output {
+public:
+    explicit Output(const Options& options) {
+        if (options.has("out")) {
+            m_file.open(options.str("out", ""));
+            if (!m_file) {
+                throw std::runtime_error("can't open output file " + options.str("out", ""));
+            }
+        }
+    }
+
+    std::ostream& stream() { return m_file.is_open() ? m_file : std::cout; }
+
+private:
+    std::ofstream m_file;
+};
+
+/**
+* @brief Zipfian generator of ranks in [0, n), rank 0 is the most frequent
+*/
+class ZipfGenerator {
+public:
+    explicit ZipfGenerator(size_t n, double skew = 0.99)
+    : m_cdf(n) {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(double(i + 1), skew);
+            m_cdf[i] = sum;
+        }
+        for (double& v : m_cdf) {
+            v /= sum;
+        }
+    }
+
+    template <typename Rng>
+    size_t operator()(Rng& rng) {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        size_t rank = size_t(std::lower_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin());
+        return std::min(rank, m_cdf.size() - 1);
+    }
+
+private:
+    std::vector<double> m_cdf;
+};
+
+/**
+* @brief Keys 0..size-1 in the insertion order for the distribution: sequential for "seq", shuffled otherwise
+*/
+inline std::vector<uint32_t> makeInsertKeys(const std::string& dist, size_t size, uint32_t seed) {
+    std::vector<uint32_t> keys(size);
+    for (size_t i = 0; i < size; ++i) {
+        keys[i] = uint32_t(i);
+    }
+    if (dist != "seq") {
+        std::mt19937 rng(seed);
+        std::shuffle(keys.begin(), keys.end(), rng);
+    }
+    return keys;
+}
+
+/**
+* @brief Stream of count keys from [0, size) following the distribution: seq, uniform or zipf.
+* Zipfian ranks are mapped to keys via a random permutation, so hot keys are spread over the container.
+*/
+inline std::vector<uint32_t> makeQueryKeys(const std::string& dist, size_t size, size_t count, uint32_t seed) {
+    std::vector<uint32_t> keys(count);
+    std::mt19937 rng(seed);
+    if (dist == "seq") {
+        for (size_t i = 0; i < count; ++i) {
+            keys[i] = uint32_t(i % size);
+        }
+    } else if (dist == "uniform") {
+        std::uniform_int_distribution<uint32_t> uniform(0, uint32_t(size - 1));
+        for (uint32_t& key : keys) {
+            key = uniform(rng);
+        }
+    } else if (dist == "zipf") {
+        std::vector<uint32_t> rankToKey = makeInsertKeys("uniform", size, seed + 1);
+        ZipfGenerator zipf(size);
+        for (uint32_t& key : keys) {
+            key = rankToKey[zipf(rng)];
+        }
+    } else {
+        throw std::invalid_argument("unknown key distribution " + dist);
+    }
+    return keys;
+}
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsedNs(Clock::time_point start, Clock::time_point end) {
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+/**
+* @brief Collection of ns/op samples, each sample is a timed batch of operations
+*/
+class Samples {
+public:
+    void add(double ns, size_t ops) {
+        m_samples.push_back(ns / double(ops));
+        m_totalNs += ns;
+        m_ops += ops;
+    }
+
+    size_t ops() const { return m_ops; }
+
+    double mean() const { return m_ops ? m_totalNs / double(m_ops) : 0; }
+
+    double percentile(double p) {
+        if (m_samples.empty()) {
+            return 0;
+        }
+        size_t pos = std::min(m_samples.size() - 1, size_t(p / 100 * double(m_samples.size())));
+        std::nth_element(m_samples.begin(), m_samples.begin() + pos, m_samples.end());
+        return m_samples[pos];
+    }
+
+    double max() const { return m_samples.empty() ? 0 : *std::max_element(m_samples.begin(), m_samples.end()); }
+
+private:
+    std::vector<double> m_samples;
+    double m_totalNs = 0;
+    size_t m_ops = 0;
+};
+
+/**
+* @brief HdrHistogram-style latency histogram of ns values with ~3% precision.
+*
+* Values below 64 are exact, larger ones go to 32 linear sub-buckets per power of 2.
+* Recording is a few instructions, so every single operation can be recorded.
+*/
+class LatencyHistogram {
+public:
+    LatencyHistogram()
+    : m_counts(kBuckets, 0) {}
+
+    void record(uint64_t ns) {
+        ++m_counts[bucketIndex(ns)];
+        ++m_count;
+        m_sum += double(ns);
+        m_max = std::max(m_max, ns);
+    }
+
+    void add(const LatencyHistogram& other) {
+        for (size_t i = 0; i < kBuckets; ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    size_t count() const { return m_count; }
+
+    double mean() const { return m_count ? m_sum / double(m_count) : 0; }
+
+    uint64_t max() const { return m_max; }
+
+    // highest value equivalent to the p-th percentile (within bucket precision)
+    uint64_t percentile(double p) const {
+        size_t rank = size_t(std::ceil(p / 100 * double(m_count)));
+        size_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += m_counts[i];
+            if (seen >= rank && seen != 0) {
+                return std::min(m_max, highestValue(i));
+            }
+        }
+        return m_max;
+    }
+
+private:
+    static constexpr unsigned kSubBits = 5;
+    static constexpr size_t kSubBuckets = size_t(1) << kSubBits;
+    static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    static size_t bucketIndex(uint64_t value) {
+        if (value < 2 * kSubBuckets) {
+            return size_t(value);
+        }
+        unsigned msb = 63 - unsigned(__builtin_clzll(value));
+        unsigned shift = msb - kSubBits;
+        return shift * kSubBuckets + size_t(value >> shift);
+    }
+
+    static uint64_t highestValue(size_t index) {
+        if (index < 2 * kSubBuckets) {
+            return index;
+        }
+        unsigned shift = unsigned(index / kSubBuckets - 1);
+        uint64_t sub = index - shift * kSubBuckets;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<size_t> m_counts;
+    size_t m_count = 0;
+    double m_sum = 0;
+    uint64_t m_max = 0;
+};
+
+/**
+* @brief Minimal streaming JSON writer, takes care of commas and string escaping
+*/
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream& out)
+    : m_out(out)
+    , m_needComma(false) {}
+
+    JsonWriter& beginObject() { prefix(); m_out << '{'; m_needComma = false; return *this; }
+
+    JsonWriter& endObject() { m_out << '}'; m_needComma = true; return *this; }
+
+    JsonWriter& beginArray() { prefix(); m_out << '['; m_needComma = false; return *this; }
+
+    JsonWriter& endArray() { m_out << ']'; m_needComma = true; return *this; }
+
+    JsonWriter& key(const std::string& name) {
+        prefix();
+        writeString(name);
+        m_out << ':';
+        m_needComma = false;
+        return *this;
+    }
+
+    JsonWriter& value(const std::string& str) { prefix(); writeString(str); m_needComma = true; return *this; }
+
+    JsonWriter& value(const char* str) { return value(std::string(str)); }
+
+    JsonWriter& value(double num) {
+        prefix();
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3f", std::isfinite(num) ? num : 0.0);
+        m_out << buf;
+        m_needComma = true;
+        return *this;
+    }
+
+    JsonWriter& value(size_t num) { prefix(); m_out << num; m_needComma = true; return *this; }
+
+    JsonWriter& value(bool flag) { prefix(); m_out << (flag ? "true" : "false"); m_needComma = true; return *this; }
+
+    template <typename Type>
+    JsonWriter& field(const std::string& name, const Type& val) { return key(name).value(val); }
+
+private:
+    void prefix() {
+        if (m_needComma) {
+            m_out << ',';
+        }
+    }
+
+    void writeString(const std::string& str) {
+        m_out << '"';
+        for (char c : str) {
+            if (c == '"' || c == '\\') {
+                m_out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                m_out << ' ';
+            } else {
+                m_out << c;
+            }
+        }
+        m_out << '"';
+    }
+
+    std::ostream& m_out;
+    bool m_needComma;
+};
+
+/**
+* @brief Write ns/op statistics as a JSON object
+*/
+inline void writeSamples(JsonWriter& json, Samples& samples) {
+    json.beginObject()
+        .field("mean", samples.mean())
+        .field("p50", samples.percentile(50))
+        .field("p90", samples.percentile(90))
+        .field("p99", samples.percentile(99))
+        .field("max", samples.max())
+        .endObject();
+}
+
+/**
+* @brief Write latency percentiles in ns as a JSON object
+*/
+inline void writeHistogram(JsonWriter& json, const LatencyHistogram& hist) {
+    json.beginObject()
+        .field("count", hist.count())
+        .field("mean", hist.mean())
+        .field("p50", size_t(hist.percentile(50)))
+        .field("p99", size_t(hist.percentile(99)))
+        .field("p99_9", size_t(hist.percentile(99.9)))
+        .field("p99_99", size_t(hist.percentile(99.99)))
+        .field("max", size_t(hist.max()))
+        .endObject();
+}
+
+int runSuite(const Options& options);
+
+int runMemory(const Options& options);
+
+int runThreads(const Options& options);
+
+int runLatency(const Options& options);
+
+int runLru(const Options& options);
+
+int runPointer(const Options& options);
+
+int runReplay(const Options& options);
+
+}
@@ -0,0 +1,132 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Workloads.h"
+
+#include <indexed/Allocator.h>
+
+#include <cstdio>
+#include <memory>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace bench {
+
+/**
+* @brief Bytes currently allocated via CountingAllocator (single-threaded use only)
+*/
+inline size_t& heapBytes() {
+    static size_t bytes = 0;
+    return bytes;
+}
+
+/**
+* @brief Allocator counting bytes requested from the heap, it's used by the std containers
+* and for the bucket arrays of the indexed unordered containers
+*/
+template <typename Type>
+class CountingAllocator : public std::allocator<Type> {
+public:
+    template <typename Type2>
+    struct rebind {
+        using other = CountingAllocator<Type2>;
+    };
+
+    CountingAllocator() = default;
+
+    template <typename Type2>
+    CountingAllocator(const CountingAllocator<Type2>&) noexcept {}
+
+    // needed for bucket array allocator obtained from indexed::Allocator
+    template <typename Type2, typename ArenaConfig>
+    CountingAllocator(const indexed::Allocator<Type2, ArenaConfig>&) noexcept {}
+
+    Type* allocate(size_t n) {
+        heapBytes() += n * sizeof(Type);
+        return std::allocator<Type>::allocate(n);
+    }
+
+    void deallocate(Type* ptr, size_t n) noexcept {
+        heapBytes() -= n * sizeof(Type);
+        std::allocator<Type>::deallocate(ptr, n);
+    }
+};
+
+template <typename Type1, typename Type2>
+bool operator==(const CountingAllocator<Type1>&, const CountingAllocator<Type2>&) noexcept { return true; }
+
+template <typename Type1, typename Type2>
+bool operator!=(const CountingAllocator<Type1>&, const CountingAllocator<Type2>&) noexcept { return false; }
+
+/**
+* @brief ArenaConfig with the bucket arrays allocated via CountingAllocator
+*/
+template <typename Base>
+struct CountingConfig : public Base {
+    template <typename Type>
+    using ArrayAllocator = CountingAllocator<Type>;
+};
+
+/**
+* @brief Bytes of Arena installed by ArenaScope, zeros for the std containers
+*/
+struct ArenaBytes {
+    size_t elementSize = 0;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+template <typename Config>
+ArenaBytes arenaBytes(const ArenaScope<Config, false>& scope) {
+    ArenaBytes res;
+    res.elementSize = scope.arena()->elementSize();
+    res.used = res.elementSize * scope.arena()->usedCapacity();
+    res.reserved = res.elementSize * scope.arena()->capacity();
+    return res;
+}
+
+template <typename Config>
+ArenaBytes arenaBytes(const ArenaScope<Config, true>&) {
+    return ArenaBytes();
+}
+
+/**
+* @brief Resident set size in bytes, 0 if unknown
+*/
+inline size_t residentBytes() {
+#ifdef __linux__
+    size_t pages = 0;
+    size_t resident = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (std::fscanf(statm, "%zu %zu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+    }
+    return resident * size_t(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+/**
+* @brief Return free heap memory to the OS, so RSS deltas are meaningful
+*/
+inline void releaseFreeHeap() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+}
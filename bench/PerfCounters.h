@@ -0,0 +1,121 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace bench {
+
+/**
+* @brief Hardware performance counters of the calling thread (Linux perf_event_open).
+*
+* Every counter is opened separately, the ones not supported by the CPU / kernel / permissions
+* are silently skipped. Only user-space events are counted. When the kernel multiplexes
+* counters the values are scaled by enabled / running time.
+*/
+class PerfCounters {
+public:
+    PerfCounters() {
+#ifdef __linux__
+        openCounter("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        openCounter("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        openCounter("branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        openCounter("l1d_misses", PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D));
+        openCounter("llc_misses", PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL));
+        openCounter("dtlb_misses", PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB));
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (const Counter& c : m_counters) {
+            close(c.fd);
+        }
+#endif
+    }
+
+    /**
+    * @brief true if at least one counter is available
+    */
+    bool available() const { return !m_counters.empty(); }
+
+    size_t size() const { return m_counters.size(); }
+
+    const std::string& name(size_t i) const { return m_counters[i].name; }
+
+    void start() {
+#ifdef __linux__
+        for (const Counter& c : m_counters) {
+            ioctl(c.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(c.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /**
+    * @brief Stop counting and add the values counted since start() to values
+    */
+    void stop(std::vector<double>& values) {
+        values.resize(m_counters.size(), 0);
+#ifdef __linux__
+        for (const Counter& c : m_counters) {
+            ioctl(c.fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        for (size_t i = 0; i < m_counters.size(); ++i) {
+            uint64_t data[3] = {0, 0, 0}; // value, time enabled, time running
+            if (read(m_counters[i].fd, data, sizeof(data)) == ssize_t(sizeof(data)) && data[2] != 0) {
+                values[i] += double(data[0]) * double(data[1]) / double(data[2]);
+            }
+        }
+#endif
+    }
+
+private:
+    struct Counter {
+        std::string name;
+        int fd;
+    };
+
+#ifdef __linux__
+    static uint64_t cacheEvent(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    void openCounter(const char name[], uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd >= 0) {
+            m_counters.push_back(Counter{name, fd});
+        }
+    }
+#endif
+
+    std::vector<Counter> m_counters;
+};
+
+}
@@ -0,0 +1,131 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "BenchUtil.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace bench {
+
+/**
+* @brief Pin the calling thread to CPU number cpu modulo number of CPUs, does nothing if not supported
+*/
+inline void pinThread(size_t cpu) {
+#ifdef __linux__
+    size_t numCpus = std::max<size_t>(1, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(int(cpu % numCpus), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+/**
+* @brief xorshift64 generator, cheap enough not to dominate allocator timings
+*/
+class XorShift {
+public:
+    explicit XorShift(uint64_t seed)
+    : m_state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint64_t next() {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return m_state;
+    }
+
+    // uniform in [0, 1)
+    double uniform() { return double(next() >> 11) * (1.0 / double(1ull << 53)); }
+
+private:
+    uint64_t m_state;
+};
+
+/**
+* @brief Spin barrier releasing all threads at once, remembers the release time
+*/
+class StartBarrier {
+public:
+    explicit StartBarrier(size_t numThreads)
+    : m_waiting(numThreads) {}
+
+    void wait() {
+        if (m_waiting.fetch_sub(1) == 1) {
+            m_start = Clock::now();
+            m_released.store(true, std::memory_order_release);
+        }
+        while (!m_released.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    // seconds since all threads were released
+    double elapsedSeconds() const { return elapsedNs(m_start, Clock::now()) * 1e-9; }
+
+private:
+    std::atomic<size_t> m_waiting;
+    std::atomic<bool> m_released{false};
+    Clock::time_point m_start;
+};
+
+/**
+* @brief Bounded single-producer single-consumer queue to pass blocks between two threads
+*/
+template <typename Type>
+class Handoff {
+public:
+    explicit Handoff(size_t capacity)
+    : m_buffer(capacity + 1)
+    , m_head(0)
+    , m_tail(0) {}
+
+    Handoff(const Handoff&) = delete;
+    Handoff& operator=(const Handoff&) = delete;
+
+    // producer side, false if full
+    bool push(const Type& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1 == m_buffer.size()) ? 0 : tail + 1;
+        if (next == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        m_buffer[tail] = value;
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false if empty
+    bool pop(Type& value) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = m_buffer[head];
+        m_head.store((head + 1 == m_buffer.size()) ? 0 : head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<Type> m_buffer;
+    std::atomic<size_t> m_head;
+    char m_pad[64]; // keep head and tail on different cache lines
+    std::atomic<size_t> m_tail;
+};
+
+}
@@ -0,0 +1,314 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/StackTop.h>
+#include <indexed/Allocator.h>
+#include <indexed/Pointer.h>
+
+#include <boost/container/list.hpp>
+#include <boost/container/slist.hpp>
+#include <boost/container/set.hpp>
+#include <boost/container/map.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/intrusive/list.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace bench {
+
+// containers with std::allocator, the baseline, a subclass can replace the allocator
+// and the Resource living for the duration of ArenaScope (e.g. a memory pool used by the allocator)
+struct StdConfig {
+    template <typename Type>
+    using Alloc = std::allocator<Type>;
+
+    struct Resource {
+        explicit Resource(size_t) {}
+    };
+};
+
+template <typename Config>
+using IsStdConfig = std::is_base_of<StdConfig, Config>;
+
+template <typename Type, typename Config, bool = IsStdConfig<Config>::value>
+struct AllocFor {
+    using type = indexed::Allocator<Type, Config>;
+};
+
+template <typename Type, typename Config>
+struct AllocFor<Type, Config, true> {
+    using type = typename Config::template Alloc<Type>;
+};
+
+template <typename Config, bool = IsStdConfig<Config>::value>
+struct VoidPtrFor {
+    using type = indexed::Pointer<void, Config>;
+};
+
+template <typename Config>
+struct VoidPtrFor<Config, true> {
+    using type = void*;
+};
+
+template <typename Config>
+size_t maxCapacityImpl(std::false_type) {
+    using Index = typename Config::IndexType;
+    size_t flagBits = Config::kAssignContainerFollowingAllocator ? 2 : 1;
+    return (size_t(1) << (sizeof(Index) * 8 - flagBits)) - 1;
+}
+
+template <typename Config>
+size_t maxCapacityImpl(std::true_type) {
+    return std::numeric_limits<size_t>::max();
+}
+
+// max number of Nodes addressable by the config
+template <typename Config>
+size_t maxCapacity() {
+    return maxCapacityImpl<Config>(IsStdConfig<Config>());
+}
+
+// creates Arena and installs it in the config for the lifetime of the scope
+template <typename Config, bool = IsStdConfig<Config>::value>
+class ArenaScope {
+public:
+    using Arena = typename Config::Arena;
+
+    explicit ArenaScope(size_t capacity)
+    : m_arena(new Arena(capacity)) {
+        Config::setArena(m_arena.get());
+        Config::setStackTop(indexed::getThreadStackTop());
+    }
+
+    ~ArenaScope() {
+        Config::setArena(nullptr);
+    }
+
+    Arena* arena() const { return m_arena.get(); }
+
+private:
+    std::unique_ptr<Arena> m_arena;
+};
+
+template <typename Config>
+class ArenaScope<Config, true> {
+public:
+    explicit ArenaScope(size_t capacity)
+    : m_resource(capacity) {}
+
+private:
+    typename Config::Resource m_resource;
+};
+
+// Nodes address a container header on stack by its offset from the stack top, the compiler can't see
+// the header address escaping that way and may drop stores to it, so make the address visible
+inline void escape(void* ptr) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r"(ptr) : "memory");
+#else
+    (void)ptr;
+#endif
+}
+
+template <size_t kSize>
+struct Payload {
+    static_assert(kSize >= sizeof(uint32_t) && kSize % sizeof(uint32_t) == 0, "wrong payload size");
+
+    uint32_t data[kSize / sizeof(uint32_t)];
+
+    Payload() = default;
+
+    explicit Payload(uint32_t key) {
+        for (uint32_t& v : data) {
+            v = key;
+        }
+    }
+
+    uint32_t key() const { return data[0]; }
+
+    bool operator<(const Payload& other) const { return key() < other.key(); }
+};
+
+// list-like containers: insert appends, query walks the list, erase pops the front
+template <typename List>
+class SequenceWorkload {
+public:
+    using Value = typename List::value_type;
+
+    SequenceWorkload() { escape(&m_list); }
+
+    void insert(uint32_t key) { m_list.emplace_back(key); }
+
+    uint32_t query(uint32_t) {
+        if (m_it == m_list.end()) {
+            m_it = m_list.begin();
+        }
+        return (*m_it++).key();
+    }
+
+    void erase(uint32_t) {
+        m_it = m_list.end();
+        m_list.pop_front();
+    }
+
+private:
+    List m_list;
+    typename List::iterator m_it = m_list.end();
+};
+
+template <typename SList>
+class SListWorkload {
+public:
+    SListWorkload() { escape(&m_list); }
+
+    void insert(uint32_t key) { m_list.emplace_front(key); }
+
+    uint32_t query(uint32_t) {
+        if (m_it == m_list.end()) {
+            m_it = m_list.begin();
+        }
+        return (*m_it++).key();
+    }
+
+    void erase(uint32_t) {
+        m_it = m_list.end();
+        m_list.pop_front();
+    }
+
+private:
+    SList m_list;
+    typename SList::iterator m_it = m_list.end();
+};
+
+template <typename Set>
+class SetWorkload {
+public:
+    using Value = typename Set::value_type;
+
+    SetWorkload() { escape(&m_set); }
+
+    void insert(uint32_t key) { m_set.emplace(key); }
+
+    uint32_t query(uint32_t key) {
+        auto it = m_set.find(Value(key));
+        return (it != m_set.end()) ? (*it).key() : 0;
+    }
+
+    void erase(uint32_t key) { m_set.erase(Value(key)); }
+
+private:
+    Set m_set;
+};
+
+template <typename Map>
+class MapWorkload {
+public:
+    using Value = typename Map::mapped_type;
+
+    MapWorkload() { escape(&m_map); }
+
+    void insert(uint32_t key) { m_map.emplace(key, Value(key)); }
+
+    uint32_t query(uint32_t key) {
+        auto it = m_map.find(key);
+        return (it != m_map.end()) ? (*it).second.key() : 0;
+    }
+
+    void erase(uint32_t key) { m_map.erase(key); }
+
+private:
+    Map m_map;
+};
+
+template <typename Config, size_t kSize>
+struct IntrusiveNode : public boost::intrusive::list_base_hook<
+                           boost::intrusive::void_pointer<typename VoidPtrFor<Config>::type>> {
+    Payload<kSize> payload;
+
+    explicit IntrusiveNode(uint32_t key)
+    : payload(key) {}
+};
+
+// intrusive list of Nodes allocated one by one via the Allocator
+template <typename Config, size_t kSize>
+class IntrusiveWorkload {
+public:
+    using Node = IntrusiveNode<Config, kSize>;
+    using Alloc = typename AllocFor<Node, Config>::type;
+    using NodePtr = typename std::allocator_traits<Alloc>::pointer;
+    using List = boost::intrusive::list<Node>;
+
+    IntrusiveWorkload()
+    : m_init(this) {
+        escape(&m_list);
+    }
+
+    ~IntrusiveWorkload() {
+        while (!m_list.empty()) {
+            erase(0);
+        }
+    }
+
+    void insert(uint32_t key) {
+        NodePtr ptr = m_alloc.allocate(1);
+        Node* node = ::new (static_cast<void*>(&*ptr)) Node(key);
+        m_list.push_back(*node);
+    }
+
+    uint32_t query(uint32_t) {
+        if (m_it == m_list.end()) {
+            m_it = m_list.begin();
+        }
+        return (*m_it++).payload.key();
+    }
+
+    void erase(uint32_t) {
+        m_it = m_list.end();
+        Node& node = m_list.front();
+        m_list.pop_front();
+        node.~Node();
+        m_alloc.deallocate(std::pointer_traits<NodePtr>::pointer_to(node), 1);
+    }
+
+private:
+    static void setContainer(void* list, std::false_type) { Config::setContainer(list); }
+
+    static void setContainer(void*, std::true_type) {}
+
+    // the list contains the head Node, Universal config must know the container before it's constructed
+    struct Init {
+        explicit Init(IntrusiveWorkload* self) { setContainer(&self->m_list, IsStdConfig<Config>()); }
+    };
+
+    Init  m_init;
+    Alloc m_alloc;
+    List  m_list;
+    typename List::iterator m_it = m_list.end();
+};
+
+template <typename Config, size_t kSize>
+struct Workloads {
+    using Value = Payload<kSize>;
+    using List = SequenceWorkload<boost::container::list<Value, typename AllocFor<Value, Config>::type>>;
+    using SList = SListWorkload<boost::container::slist<Value, typename AllocFor<Value, Config>::type>>;
+    using Set = SetWorkload<boost::container::set<Value, std::less<Value>, typename AllocFor<Value, Config>::type>>;
+    using MapPair = std::pair<const uint32_t, Value>;
+    using MapAlloc = typename AllocFor<MapPair, Config>::type;
+    using Map = MapWorkload<boost::container::map<uint32_t, Value, std::less<uint32_t>, MapAlloc>>;
+    using UnMap = MapWorkload<boost::unordered_map<uint32_t, Value, boost::hash<uint32_t>,
+                                                   std::equal_to<uint32_t>, MapAlloc>>;
+    using Intrusive = IntrusiveWorkload<Config, kSize>;
+};
+
+}
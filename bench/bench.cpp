@@ -4,6 +4,8 @@
 //    (See accompanying file ../LICENSE_1_0.txt or copy at
 //          https://www.boost.org/LICENSE_1_0.txt)
 
+#include "BenchUtil.h"
+
 #include <indexed/StackTop.h>
 #include <indexed/NewAlloc.h>
 #include <indexed/ArrayArena.h>
@@ -11,6 +13,8 @@
 #include <indexed/Allocator.h>
 #include <indexed/SingleArenaConfig.h>
 #include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/FrozenMap.h>
+#include <indexed/ArenaScan.h>
 
 #include <boost/container/map.hpp>
 #include <boost/unordered_map.hpp>
@@ -76,6 +80,12 @@ void map_quick_insert(const char name[], bool showOutput = true);
 template <typename Map>
 void map_query(const char name[], bool showOutput = true);
 
+template <typename Map>
+void map_query_frozen(const char name[], bool showOutput = true);
+
+template <typename Map>
+void map_scan(const char name[], bool showOutput = true);
+
 template <typename Map>
 void map_insert_and_remove(const char name[], bool showOutput = true);
 
@@ -141,6 +151,8 @@ void benchSingleThread() {
     arena.reset();
     bench.template map_query<IndMap>("Query with indexed map");
     bench.template map_query<Map>("Query with map");
+    bench.template map_query_frozen<IndMap>("Query with frozen indexed map");
+    bench.template map_scan<IndMap>("Scan with indexed map (iteration / arena scan)");
     arena.enableDelete(true);
     arena.reset();
     bench.template map_insert_and_remove<IndMap>("Insert and remove with indexed map");
@@ -224,15 +236,68 @@ void benchMultiThreadPerThread() {
     cout << (bench.dummy ? "" : " ") << endl;
 }
 
-int main() {
+void printUsage() {
+    cout << "Usage: Bench [mode [options]]" << endl
+         << "  without mode runs the default fixed scenarios, prints wall time in ms" << endl
+         << "  suite   sweep of container/index/config/payload/distribution/size, JSON output" << endl
+         << "          --containers=list,slist,set,map,unordered,intrusive --index=16,32" << endl
+         << "          --config=static,universal,std --payload=4,16,64 --dist=seq,uniform,zipf" << endl
+         << "          --size=1000,10000,100000 --ops=100000 --repeat=3 --seed=1 --out=file.json" << endl
+         << "          baseline configs: bump,boost_pool,boost_fast_pool,pmr_pool,pmr_sync_pool (pmr needs C++17)" << endl
+         << "          --perf adds hardware counters per operation (Linux perf_event_open)" << endl
+         << "  memory  memory footprint per container/index/config/payload/size, JSON output" << endl
+         << "          --containers=list,slist,set,map,unordered,intrusive --index=16,32" << endl
+         << "          --config=static,universal,std --payload=4,16,64 --size=1000,10000,30000,1000000" << endl
+         << "          --out=file.json" << endl
+         << "  threads thread-scaling sweep of shared ArrayArenaMT vs per-thread ArrayArena vs malloc, JSON output" << endl
+         << "          --arena=mt,tl,tl-inbox,malloc --threads=1,2,4 --alloc-ratio=0.5,0.8 --cross-ratio=0,0.5" << endl
+         << "          --live=1024 --element=32 --ops=1000000 --out=file.json" << endl
+         << "  latency per-operation latency histograms (p50/p99/p99.9/max in ns) per thread count, JSON output" << endl
+         << "          --op=alloc,container --arena=arena,arena-mmap,mt,mt-mmap,malloc --threads=1,2,4" << endl
+         << "          --live=10000 --element=32 --ops=1000000 --out=file.json" << endl
+         << "  lru     LRU cache trace replay, indexed vs std pointers: hit rate, Mops/s, memory, JSON output" << endl
+         << "          --trace=file (lines \"get|put|erase <key>\") or zipfian --keys=1000000 --ops=2000000" << endl
+         << "          --get-ratio=0.9 --erase-ratio=0.01 --seed=1 --capacity=1000,10000,16000,100000" << endl
+         << "          --cache=indexed16,indexed32,std --out=file.json" << endl
+         << "  pointer Pointer decode microbenchmark: dependent chain / independent stream deref, pointer_to," << endl
+         << "          allocate per config, index width and node location, JSON output" << endl
+         << "          --config=raw,static,perthread,universal,universal_perthread --index=16,32" << endl
+         << "          --location=arena,stack --nodes=1024,4096 --ops=10000000 --seed=1 --out=file.json" << endl
+         << "  replay  replay of an Arena trace recorded by RecordingArena against Arena variants per object size:" << endl
+         << "          peak usage, required capacity, fragmentation, ns per event, JSON output" << endl
+         << "          --trace=file or record a map workload --record=arena.trace --live=10000 --ops=1000000 --seed=1" << endl
+         << "          --arena=lifo16,lifo32,nodelete32,mt32 --capacity=(recorded) --headroom=1.25 --out=file.json" << endl;
+}
+
+int main(int argc, char* argv[]) {
 #ifndef NDEBUG
     cout << "You run the benchmark compiled not in Release mode!" << endl;
 #endif
     try {
-        benchSingleThread<ArenaConfig>();
-        benchSingleThread<ArenaConfigUniversal>();
-        benchMultiThreadPerThread();
-        benchMultiThreadShared();
+        string mode = (argc > 1) ? argv[1] : "";
+        if (mode.empty()) {
+            benchSingleThread<ArenaConfig>();
+            benchSingleThread<ArenaConfigUniversal>();
+            benchMultiThreadPerThread();
+            benchMultiThreadShared();
+        } else if (mode == "suite") {
+            return bench::runSuite(bench::Options(argc - 2, argv + 2));
+        } else if (mode == "memory") {
+            return bench::runMemory(bench::Options(argc - 2, argv + 2));
+        } else if (mode == "threads") {
+            return bench::runThreads(bench::Options(argc - 2, argv + 2));
+        } else if (mode == "latency") {
+            return bench::runLatency(bench::Options(argc - 2, argv + 2));
+        } else if (mode == "lru") {
+            return bench::runLru(bench::Options(argc - 2, argv + 2));
+        } else if (mode == "pointer") {
+            return bench::runPointer(bench::Options(argc - 2, argv + 2));
+        } else if (mode == "replay") {
+            return bench::runReplay(bench::Options(argc - 2, argv + 2));
+        } else {
+            printUsage();
+            return (mode == "--help") ? 0 : 1;
+        }
     } catch(const exception& ex) {
         cerr << "Bench exit with exception " << ex.what() << endl;
         return 1;
@@ -301,6 +366,78 @@ void Bench<Config>::map_query(const char name[], bool showOutput) {
     this->dummy |= dummy;
 }
 
+template <typename Config>
+template <typename Map>
+void Bench<Config>::map_query_frozen(const char name[], bool showOutput) {
+    auto locArena = useLocalArenaIfNeeded(false);
+    FrozenMap<Key, Value> frozen;
+    {
+        Map map;
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < m; ++j) {
+                int key = int(j * n + i);
+                map.emplace(2 * key, 1);
+            }
+        }
+        frozen.freeze(map);
+    }
+
+    size_t dummy = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t k = 0; k < repeat; ++k) {
+        for (size_t i = n; i > 0; --i) {
+            for (size_t j = 0; j < m; ++j) {
+                int key = int(j * n + i - 1);
+                dummy += *frozen.find(2 * key);
+                dummy += frozen.count(2 * key + 1);
+            }
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+    auto time = chrono::duration_cast<chrono::milliseconds>(end - start).count();
+
+    if (showOutput) {
+        cout << name << ": wall time " << time << endl;
+    }
+    this->dummy |= dummy;
+}
+
+template <typename Config>
+template <typename Map>
+void Bench<Config>::map_scan(const char name[], bool showOutput) {
+    auto locArena = useLocalArenaIfNeeded(false);
+    Map map;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+            int key = int(j * n + i);
+            map.emplace(2 * key, 1);
+        }
+    }
+
+    size_t dummy = 0;
+    auto start = chrono::high_resolution_clock::now();
+    const Map& cmap = map;
+    for (size_t k = 0; k < repeat; ++k) {
+        for (auto it = cmap.begin(); it != cmap.end(); ++it) {
+            dummy += (*it).second;
+        }
+    }
+    auto middle = chrono::high_resolution_clock::now();
+    for (size_t k = 0; k < repeat; ++k) {
+        forEachElement(map, *Config::getArena(), [&dummy](const typename Map::value_type& element) {
+            dummy += element.second;
+        });
+    }
+    auto end = chrono::high_resolution_clock::now();
+    auto iterTime = chrono::duration_cast<chrono::milliseconds>(middle - start).count();
+    auto scanTime = chrono::duration_cast<chrono::milliseconds>(end - middle).count();
+
+    if (showOutput) {
+        cout << name << ": wall time " << iterTime << " / " << scanTime << endl;
+    }
+    this->dummy |= dummy;
+}
+
 template <typename Config>
 template <typename Map>
 void Bench<Config>::map_insert_and_remove(const char name[], bool showOutput) {
@@ -0,0 +1,295 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchUtil.h"
+#include "ThreadUtil.h"
+#include "Workloads.h"
+
+#include <indexed/StackTop.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/MmapAlloc.h>
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/SingleArenaConfig.h>
+
+#include <boost/container/map.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace indexed;
+
+namespace bench {
+
+namespace {
+
+using ArenaNew = ArrayArena<uint32_t, NewAlloc>;
+using ArenaMmap = ArrayArena<uint32_t, MmapAlloc>;
+using ArenaMTNew = ArrayArenaMT<uint32_t, NewAlloc>;
+using ArenaMTMmap = ArrayArenaMT<uint32_t, MmapAlloc>;
+
+struct ConfigNew : public SingleArenaConfigPerThread<ArenaNew, ConfigNew> {};
+struct ConfigMmap : public SingleArenaConfigPerThread<ArenaMmap, ConfigMmap> {};
+struct ConfigMTNew : public SingleArenaConfigPerThread<ArenaMTNew, ConfigMTNew> {};
+struct ConfigMTMmap : public SingleArenaConfigPerThread<ArenaMTMmap, ConfigMTMmap> {};
+
+struct Params {
+    size_t threads;
+    size_t live;
+    size_t ops;
+    size_t elementSize;
+};
+
+// latencies of the two measured operations: allocate / deallocate or insert / erase
+struct OpHistograms {
+    LatencyHistogram first;
+    LatencyHistogram second;
+
+    void add(const OpHistograms& other) {
+        first.add(other.first);
+        second.add(other.second);
+    }
+};
+
+// Arena per thread or one shared Arena, created before the run, so the first allocation
+// (buffer allocation and page faults) is measured
+template <typename Arena, bool kShared>
+class ArenaSource {
+public:
+    explicit ArenaSource(const Params& params) {
+        size_t count = kShared ? 1 : params.threads;
+        size_t capacity = (kShared ? params.threads : 1) * (params.live + 2);
+        for (size_t i = 0; i < count; ++i) {
+            m_arenas.emplace_back(new Arena(capacity));
+        }
+    }
+
+    Arena* forThread(size_t thread) { return m_arenas[kShared ? 0 : thread].get(); }
+
+private:
+    vector<unique_ptr<Arena>> m_arenas;
+};
+
+class MallocSource {
+public:
+    explicit MallocSource(const Params&) {}
+
+    MallocSource* forThread(size_t) { return this; }
+};
+
+template <typename Arena>
+uint64_t allocateBlock(Arena* arena, size_t size) {
+    uint32_t index = arena->allocate(size);
+    memset(arena->getElement(index), 1, size);
+    return index;
+}
+
+template <typename Arena>
+void deallocateBlock(Arena* arena, uint64_t block, size_t size) {
+    arena->deallocate(uint32_t(block), size);
+}
+
+uint64_t allocateBlock(MallocSource*, size_t size) {
+    void* ptr = malloc(size);
+    if (!ptr) {
+        throw bad_alloc();
+    }
+    memset(ptr, 1, size);
+    return reinterpret_cast<uintptr_t>(ptr);
+}
+
+void deallocateBlock(MallocSource*, uint64_t block, size_t) {
+    free(reinterpret_cast<void*>(uintptr_t(block)));
+}
+
+template <typename Config>
+void bindArena(typename Config::Arena* arena, std::false_type) {
+    Config::setArena(arena);
+    Config::setStackTop(getThreadStackTop());
+}
+
+template <typename Config>
+void bindArena(MallocSource*, std::true_type) {}
+
+// Every thread runs op(t, histograms) after the others are ready, the histograms are merged
+template <typename Op>
+OpHistograms runParallel(const Params& params, Op op) {
+    vector<OpHistograms> perThread(params.threads);
+    StartBarrier barrier(params.threads);
+    vector<thread> threads;
+    for (size_t t = 0; t < params.threads; ++t) {
+        threads.emplace_back([&, t] {
+            pinThread(t);
+            barrier.wait();
+            op(t, perThread[t]);
+        });
+    }
+    for (thread& th : threads) {
+        th.join();
+    }
+    OpHistograms res;
+    for (const OpHistograms& h : perThread) {
+        res.add(h);
+    }
+    return res;
+}
+
+inline uint64_t timedNs(Clock::time_point start) {
+    return uint64_t(elapsedNs(start, Clock::now()));
+}
+
+// random allocate / deallocate keeping at most live blocks per thread
+template <typename Source>
+OpHistograms runAlloc(const Params& params) {
+    Source source(params);
+    return runParallel(params, [&](size_t t, OpHistograms& hist) {
+        auto arena = source.forThread(t);
+        vector<uint64_t> live;
+        live.reserve(params.live);
+        XorShift rng(t + 1);
+        for (size_t k = 0; k < params.ops; ++k) {
+            if (live.empty() || (live.size() < params.live && (rng.next() & 1))) {
+                auto start = Clock::now();
+                uint64_t block = allocateBlock(arena, params.elementSize);
+                hist.first.record(timedNs(start));
+                live.push_back(block);
+            } else {
+                size_t pos = rng.next() % live.size();
+                uint64_t block = live[pos];
+                live[pos] = live.back();
+                live.pop_back();
+                auto start = Clock::now();
+                deallocateBlock(arena, block, params.elementSize);
+                hist.second.record(timedNs(start));
+            }
+        }
+        for (uint64_t block : live) {
+            deallocateBlock(arena, block, params.elementSize);
+        }
+    });
+}
+
+// random insert / erase of unique keys in a map with at most live elements per thread
+template <typename Config, typename Source>
+OpHistograms runContainer(const Params& params) {
+    using Alloc = typename AllocFor<pair<const uint32_t, uint32_t>, Config>::type;
+    using Map = boost::container::map<uint32_t, uint32_t, less<uint32_t>, Alloc>;
+    Source source(params);
+    return runParallel(params, [&](size_t t, OpHistograms& hist) {
+        bindArena<Config>(source.forThread(t), IsStdConfig<Config>());
+        Map map;
+        escape(&map);
+        vector<uint32_t> live;
+        live.reserve(params.live);
+        XorShift rng(t + 1);
+        uint32_t nextKey = 0;
+        for (size_t k = 0; k < params.ops; ++k) {
+            if (live.empty() || (live.size() < params.live && (rng.next() & 1))) {
+                uint32_t key = nextKey++;
+                auto start = Clock::now();
+                map.emplace(key, key);
+                hist.first.record(timedNs(start));
+                live.push_back(key);
+            } else {
+                size_t pos = rng.next() % live.size();
+                uint32_t key = live[pos];
+                live[pos] = live.back();
+                live.pop_back();
+                auto start = Clock::now();
+                map.erase(key);
+                hist.second.record(timedNs(start));
+            }
+        }
+    });
+}
+
+OpHistograms runCase(const string& op, const string& arena, const Params& params) {
+    if (op == "alloc") {
+        if (arena == "arena") {
+            return runAlloc<ArenaSource<ArenaNew, false>>(params);
+        } else if (arena == "arena-mmap") {
+            return runAlloc<ArenaSource<ArenaMmap, false>>(params);
+        } else if (arena == "mt") {
+            return runAlloc<ArenaSource<ArenaMTNew, true>>(params);
+        } else if (arena == "mt-mmap") {
+            return runAlloc<ArenaSource<ArenaMTMmap, true>>(params);
+        } else if (arena == "malloc") {
+            return runAlloc<MallocSource>(params);
+        }
+    } else if (op == "container") {
+        if (arena == "arena") {
+            return runContainer<ConfigNew, ArenaSource<ArenaNew, false>>(params);
+        } else if (arena == "arena-mmap") {
+            return runContainer<ConfigMmap, ArenaSource<ArenaMmap, false>>(params);
+        } else if (arena == "mt") {
+            return runContainer<ConfigMTNew, ArenaSource<ArenaMTNew, true>>(params);
+        } else if (arena == "mt-mmap") {
+            return runContainer<ConfigMTMmap, ArenaSource<ArenaMTMmap, true>>(params);
+        } else if (arena == "malloc") {
+            return runContainer<StdConfig, MallocSource>(params);
+        }
+    } else {
+        throw invalid_argument("unknown operation " + op);
+    }
+    throw invalid_argument("unknown arena " + arena);
+}
+
+// latency of an empty Clock::now() pair, it's included in every recorded value
+uint64_t timerOverheadNs() {
+    LatencyHistogram hist;
+    for (size_t i = 0; i < 100000; ++i) {
+        hist.record(timedNs(Clock::now()));
+    }
+    return hist.percentile(50);
+}
+
+}
+
+int runLatency(const Options& options) {
+    Output output(options);
+    ostream& out = output.stream();
+    JsonWriter json(out);
+    Params params;
+    params.live = options.num("live", 10000);
+    params.ops = options.num("ops", 1000000);
+    params.elementSize = options.num("element", 32);
+    json.beginObject()
+        .field("benchmark", "latency")
+        .field("unit", "ns")
+        .field("timer_overhead_ns", size_t(timerOverheadNs()))
+        .field("live_per_thread", params.live)
+        .field("ops_per_thread", params.ops)
+        .field("element_size", params.elementSize);
+    json.key("results").beginArray();
+    for (const string& op : options.list("op", "alloc,container")) {
+        bool isAlloc = (op == "alloc");
+        for (const string& arena : options.list("arena", "arena,arena-mmap,mt,mt-mmap,malloc")) {
+            for (size_t threads : options.numList("threads", "1,2,4")) {
+                params.threads = threads;
+                OpHistograms hist = runCase(op, arena, params);
+                json.beginObject()
+                    .field("op", op)
+                    .field("arena", arena)
+                    .field("threads", threads);
+                json.key(isAlloc ? "allocate" : "insert");
+                writeHistogram(json, hist.first);
+                json.key(isAlloc ? "deallocate" : "erase");
+                writeHistogram(json, hist.second);
+                json.endObject();
+            }
+        }
+    }
+    json.endArray().endObject();
+    out << endl;
+    return 0;
+}
+
+}
@@ -0,0 +1,309 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchUtil.h"
+#include "MemoryUtil.h"
+#include "Workloads.h"
+
+#include <indexed/NewAlloc.h>
+#include <indexed/ArrayArena.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+
+#include <boost/intrusive/list.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+using namespace std;
+using namespace indexed;
+
+namespace bench {
+
+namespace {
+
+template <typename Index>
+using Arena = ArrayArena<Index, NewAlloc>;
+
+// the list header is inside LruCache, so Universal config is required, see tests/intrusive_test.cpp
+template <typename Index, typename ConfigClass>
+struct LruConfig : public CountingConfig<SingleArenaConfigUniversalStatic<Arena<Index>, ConfigClass>> {
+    // LruCache calls setContainer() on its own
+    static constexpr bool kAssignContainerFollowingAllocator = false;
+};
+
+struct ConfigLru16 : public LruConfig<uint16_t, ConfigLru16> {};
+struct ConfigLru32 : public LruConfig<uint32_t, ConfigLru32> {};
+
+struct CountingStdConfig : public StdConfig {
+    template <typename Type>
+    using Alloc = CountingAllocator<Type>;
+};
+
+/**
+* LRU cache: unordered_map of keys with intrusive list hooks, the list keeps the usage order.
+* The same construction as in tests/intrusive_test.cpp, with std pointers for StdConfig.
+*/
+template <typename Config>
+class LruCache {
+public:
+    struct Key : public boost::intrusive::list_base_hook<
+                     boost::intrusive::void_pointer<typename VoidPtrFor<Config>::type>> {
+        uint64_t key;
+
+        Key(uint64_t k)
+        : key(k) {}
+
+        bool operator==(const Key& other) const { return key == other.key; }
+    };
+
+    struct Hasher {
+        size_t operator()(const Key& val) const { return boost::hash<uint64_t>()(val.key); }
+    };
+
+    using Pair = pair<const Key, uint64_t>;
+    using Alloc = typename AllocFor<Pair, Config>::type;
+    using Map = boost::unordered_map<Key, uint64_t, Hasher, equal_to<Key>, Alloc>;
+    using List = boost::intrusive::list<Key>;
+
+    explicit LruCache(size_t capacity)
+    : m_init(&m_list)
+    , m_capacity(capacity) {}
+
+    size_t size() const { return m_map.size(); }
+
+    // true on hit, the key becomes the most recently used
+    bool get(uint64_t key) {
+        auto it = m_map.find(Key(key));
+        if (it == m_map.end()) {
+            return false;
+        }
+        touch((*it).first);
+        return true;
+    }
+
+    void put(uint64_t key, uint64_t value) {
+        auto it = m_map.find(Key(key));
+        if (it != m_map.end()) {
+            (*it).second = value;
+            touch((*it).first);
+            return;
+        }
+        if (m_map.size() == m_capacity) {
+            uint64_t oldKey = m_list.front().key;
+            m_list.pop_front();
+            m_map.erase(Key(oldKey));
+        }
+        auto res = m_map.emplace(Key(key), value);
+        m_list.push_back(const_cast<Key&>((*res.first).first));
+    }
+
+    void erase(uint64_t key) {
+        auto it = m_map.find(Key(key));
+        if (it != m_map.end()) {
+            m_list.erase(m_list.iterator_to((*it).first));
+            m_map.erase(it);
+        }
+    }
+
+private:
+    struct Init {
+        Init(List* list) { setContainer(list, IsStdConfig<Config>()); }
+
+        static void setContainer(List* list, std::false_type) { Config::setContainer(list); }
+
+        static void setContainer(List*, std::true_type) {}
+    };
+
+    void touch(const Key& node) {
+        if (&node != &m_list.back()) {
+            m_list.erase(m_list.iterator_to(node));
+            m_list.push_back(const_cast<Key&>(node));
+        }
+    }
+
+    Init m_init;
+    Map m_map;
+    List m_list;
+    size_t m_capacity;
+};
+
+enum class TraceOp : uint8_t { Get, Put, Erase };
+
+struct TraceEntry {
+    TraceOp op;
+    uint64_t key;
+};
+
+// text trace, one "get|put|erase <key>" per line, empty lines and lines starting with # are skipped
+vector<TraceEntry> readTrace(const string& fileName) {
+    ifstream file(fileName);
+    if (!file) {
+        throw runtime_error("can't open trace file " + fileName);
+    }
+    vector<TraceEntry> trace;
+    string line;
+    size_t lineNum = 0;
+    while (getline(file, line)) {
+        ++lineNum;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        istringstream stream(line);
+        string op;
+        TraceEntry entry;
+        if (!(stream >> op >> entry.key)) {
+            throw runtime_error("wrong trace line " + to_string(lineNum) + ": " + line);
+        }
+        if (op == "get") {
+            entry.op = TraceOp::Get;
+        } else if (op == "put") {
+            entry.op = TraceOp::Put;
+        } else if (op == "erase") {
+            entry.op = TraceOp::Erase;
+        } else {
+            throw runtime_error("unknown trace operation " + op + " in line " + to_string(lineNum));
+        }
+        trace.push_back(entry);
+    }
+    return trace;
+}
+
+// zipfian keys, an operation is get with getRatio probability, erase with eraseRatio and put otherwise
+vector<TraceEntry> makeTrace(size_t keys, size_t ops, double getRatio, double eraseRatio, uint32_t seed) {
+    vector<uint32_t> rankToKey = makeInsertKeys("uniform", keys, seed);
+    ZipfGenerator zipf(keys);
+    mt19937 rng(seed + 1);
+    uniform_real_distribution<double> uniform(0, 1);
+    vector<TraceEntry> trace(ops);
+    for (TraceEntry& entry : trace) {
+        entry.key = rankToKey[zipf(rng)];
+        double u = uniform(rng);
+        entry.op = (u < getRatio) ? TraceOp::Get : (u < getRatio + eraseRatio) ? TraceOp::Erase : TraceOp::Put;
+    }
+    return trace;
+}
+
+struct ReplayResult {
+    size_t gets = 0;
+    size_t hits = 0;
+    size_t entries = 0;
+    double ns = 0;
+    size_t heapBytes = 0;
+    ArenaBytes arena;
+};
+
+// a get miss fills the cache (read-through), so all caches see the same sequence of operations
+template <typename Config>
+ReplayResult replay(const vector<TraceEntry>& trace, size_t capacity) {
+    ReplayResult res;
+    size_t heapBefore = heapBytes();
+    ArenaScope<Config> scope(capacity + 2); // unordered map allocates one extra Node
+    {
+        unique_ptr<LruCache<Config>> cache(new LruCache<Config>(capacity));
+        auto start = Clock::now();
+        for (const TraceEntry& entry : trace) {
+            switch (entry.op) {
+            case TraceOp::Get:
+                ++res.gets;
+                if (cache->get(entry.key)) {
+                    ++res.hits;
+                } else {
+                    cache->put(entry.key, entry.key);
+                }
+                break;
+            case TraceOp::Put:
+                cache->put(entry.key, entry.key);
+                break;
+            case TraceOp::Erase:
+                cache->erase(entry.key);
+                break;
+            }
+        }
+        res.ns = elapsedNs(start, Clock::now());
+        res.entries = cache->size();
+        res.heapBytes = heapBytes() - heapBefore;
+        res.arena = arenaBytes(scope);
+    }
+    return res;
+}
+
+ReplayResult runCache(const string& cache, const vector<TraceEntry>& trace, size_t capacity) {
+    if (cache == "indexed16") {
+        return replay<ConfigLru16>(trace, capacity);
+    } else if (cache == "indexed32") {
+        return replay<ConfigLru32>(trace, capacity);
+    } else if (cache == "std") {
+        return replay<CountingStdConfig>(trace, capacity);
+    }
+    throw invalid_argument("unknown cache " + cache);
+}
+
+// Universal config uses 2 bits of the index as flags
+size_t maxLruCapacity(const string& cache) {
+    if (cache == "indexed16") {
+        return (size_t(1) << 14) - 3;
+    } else if (cache == "indexed32") {
+        return (size_t(1) << 30) - 3;
+    }
+    return numeric_limits<size_t>::max();
+}
+
+}
+
+int runLru(const Options& options) {
+    Output output(options);
+    ostream& out = output.stream();
+    JsonWriter json(out);
+    vector<TraceEntry> trace;
+    string source;
+    if (options.has("trace")) {
+        source = options.str("trace", "");
+        trace = readTrace(source);
+    } else {
+        source = "zipf";
+        trace = makeTrace(options.num("keys", 1000000), options.num("ops", 2000000),
+                          stod(options.str("get-ratio", "0.9")), stod(options.str("erase-ratio", "0.01")),
+                          uint32_t(options.num("seed", 1)));
+    }
+    json.beginObject()
+        .field("benchmark", "lru")
+        .field("trace", source)
+        .field("ops", trace.size());
+    json.key("results").beginArray();
+    for (size_t capacity : options.numList("capacity", "1000,10000,16000,100000")) {
+        for (const string& cache : options.list("cache", "indexed16,indexed32,std")) {
+            if (capacity > maxLruCapacity(cache)) {
+                cerr << "skip " << cache << " capacity " << capacity << ": too many Nodes for the index type" << endl;
+                continue;
+            }
+            ReplayResult res = runCache(cache, trace, capacity);
+            size_t bytes = res.arena.used + res.heapBytes;
+            json.beginObject()
+                .field("cache", cache)
+                .field("capacity", capacity)
+                .field("hit_rate", res.gets ? double(res.hits) / double(res.gets) : 0.0)
+                .field("mops_per_sec", double(trace.size()) * 1e3 / res.ns)
+                .field("ns_per_op", res.ns / double(trace.size()))
+                .field("entries", res.entries)
+                .field("element_size", res.arena.elementSize)
+                .field("arena_bytes_used", res.arena.used)
+                .field("heap_bytes", res.heapBytes)
+                .field("bytes_per_entry", res.entries ? double(bytes) / double(res.entries) : 0.0)
+                .endObject();
+        }
+    }
+    json.endArray().endObject();
+    out << endl;
+    return 0;
+}
+
+}
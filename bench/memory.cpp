@@ -0,0 +1,170 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchUtil.h"
+#include "MemoryUtil.h"
+#include "Workloads.h"
+
+#include <indexed/NewAlloc.h>
+#include <indexed/ArrayArena.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+
+#include <iostream>
+#include <cstdint>
+#include <memory>
+
+using namespace std;
+using namespace indexed;
+
+namespace bench {
+
+namespace {
+
+template <typename Index>
+using Arena = ArrayArena<Index, NewAlloc>;
+
+struct ConfigStatic16 : public CountingConfig<SingleArenaConfigStatic<Arena<uint16_t>, ConfigStatic16>> {};
+struct ConfigStatic32 : public CountingConfig<SingleArenaConfigStatic<Arena<uint32_t>, ConfigStatic32>> {};
+struct ConfigUniversal16 : public CountingConfig<SingleArenaConfigUniversalStatic<Arena<uint16_t>, ConfigUniversal16>> {};
+struct ConfigUniversal32 : public CountingConfig<SingleArenaConfigUniversalStatic<Arena<uint32_t>, ConfigUniversal32>> {};
+
+struct CountingStdConfig : public StdConfig {
+    template <typename Type>
+    using Alloc = CountingAllocator<Type>;
+};
+
+struct Case {
+    string container;
+    string config;
+    size_t index;
+    size_t payload;
+    size_t size;
+};
+
+template <typename Workload, typename Config>
+void runCase(const Case& c, JsonWriter& json) {
+    if (c.size + 2 > maxCapacity<Config>()) {
+        cerr << "skip " << c.container << " " << c.config << c.index << " size " << c.size
+             << ": too many Nodes for the index type" << endl;
+        return;
+    }
+    releaseFreeHeap();
+    size_t heapBefore = heapBytes();
+    size_t rssBefore = residentBytes();
+    ArenaScope<Config> scope(c.size + 2); // unordered map allocates one extra Node
+    Workload workload;
+    for (size_t i = 0; i < c.size; ++i) {
+        workload.insert(uint32_t(i));
+    }
+    // RSS may shrink (e.g. pages reclaimed under memory pressure), the delta is clamped at 0
+    size_t rssAfter = residentBytes();
+    size_t rssDelta = (rssAfter > rssBefore) ? rssAfter - rssBefore : 0;
+    size_t heap = heapBytes() - heapBefore;
+    ArenaBytes arena = arenaBytes(scope);
+    json.beginObject()
+        .field("container", c.container)
+        .field("config", c.config)
+        .field("index_bits", c.index)
+        .field("payload_bytes", c.payload)
+        .field("size", c.size)
+        .field("element_size", arena.elementSize)
+        .field("arena_bytes_used", arena.used)
+        .field("arena_bytes_reserved", arena.reserved)
+        .field("heap_bytes", heap)
+        .field("rss_delta_bytes", rssDelta)
+        .field("bytes_per_element", double(arena.used + heap) / double(c.size))
+        .field("rss_bytes_per_element", double(rssDelta) / double(c.size))
+        .endObject();
+}
+
+template <typename Config, size_t kSize>
+void runContainers(Case c, const Options& options, JsonWriter& json) {
+    using W = Workloads<Config, kSize>;
+    for (const string& container : options.list("containers", "list,slist,set,map,unordered,intrusive")) {
+        c.container = container;
+        for (size_t size : options.numList("size", "1000,10000,30000,1000000")) {
+            c.size = size;
+            if (container == "list") {
+                runCase<typename W::List, Config>(c, json);
+            } else if (container == "slist") {
+                runCase<typename W::SList, Config>(c, json);
+            } else if (container == "set") {
+                runCase<typename W::Set, Config>(c, json);
+            } else if (container == "map") {
+                runCase<typename W::Map, Config>(c, json);
+            } else if (container == "unordered") {
+                runCase<typename W::UnMap, Config>(c, json);
+            } else if (container == "intrusive") {
+                runCase<typename W::Intrusive, Config>(c, json);
+            } else {
+                throw invalid_argument("unknown container " + container);
+            }
+        }
+    }
+}
+
+template <typename Config>
+void runPayloads(Case c, const Options& options, JsonWriter& json) {
+    for (size_t payload : options.numList("payload", "4,16")) {
+        c.payload = payload;
+        switch (payload) {
+        case 4:
+            runContainers<Config, 4>(c, options, json);
+            break;
+        case 16:
+            runContainers<Config, 16>(c, options, json);
+            break;
+        case 64:
+            runContainers<Config, 64>(c, options, json);
+            break;
+        default:
+            throw invalid_argument("payload must be 4, 16 or 64");
+        }
+    }
+}
+
+void runConfigs(const Options& options, JsonWriter& json) {
+    Case c;
+    for (const string& config : options.list("config", "static,std")) {
+        c.config = config;
+        if (config == "std") {
+            c.index = 64;
+            runPayloads<CountingStdConfig>(c, options, json);
+            continue;
+        }
+        for (size_t index : options.numList("index", "16,32")) {
+            c.index = index;
+            if (config == "static" && index == 16) {
+                runPayloads<ConfigStatic16>(c, options, json);
+            } else if (config == "static" && index == 32) {
+                runPayloads<ConfigStatic32>(c, options, json);
+            } else if (config == "universal" && index == 16) {
+                runPayloads<ConfigUniversal16>(c, options, json);
+            } else if (config == "universal" && index == 32) {
+                runPayloads<ConfigUniversal32>(c, options, json);
+            } else {
+                throw invalid_argument("unknown config " + config + " or index " + to_string(index));
+            }
+        }
+    }
+}
+
+}
+
+int runMemory(const Options& options) {
+    Output output(options);
+    ostream& out = output.stream();
+    JsonWriter json(out);
+    json.beginObject().field("benchmark", "memory");
+    json.key("results").beginArray();
+    runConfigs(options, json);
+    json.endArray().endObject();
+    out << endl;
+    return 0;
+}
+
+}
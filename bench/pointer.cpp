@@ -0,0 +1,300 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchUtil.h"
+#include "Workloads.h"
+
+#include <indexed/StackTop.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/ArrayArena.h>
+#include <indexed/Allocator.h>
+#include <indexed/Pointer.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+
+#include <array>
+#include <iostream>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace indexed;
+
+namespace bench {
+
+namespace {
+
+constexpr size_t kMaxStackNodes = 4096;
+
+template <typename Index>
+using Arena = ArrayArena<Index, NewAlloc>;
+
+struct Static16 : public SingleArenaConfigStatic<Arena<uint16_t>, Static16> {};
+struct Static32 : public SingleArenaConfigStatic<Arena<uint32_t>, Static32> {};
+struct PerThread16 : public SingleArenaConfigPerThread<Arena<uint16_t>, PerThread16> {};
+struct PerThread32 : public SingleArenaConfigPerThread<Arena<uint32_t>, PerThread32> {};
+struct Universal16 : public SingleArenaConfigUniversalStatic<Arena<uint16_t>, Universal16> {};
+struct Universal32 : public SingleArenaConfigUniversalStatic<Arena<uint32_t>, Universal32> {};
+struct UniversalPerThread16 : public SingleArenaConfigUniversalPerThread<Arena<uint16_t>, UniversalPerThread16> {};
+struct UniversalPerThread32 : public SingleArenaConfigUniversalPerThread<Arena<uint32_t>, UniversalPerThread32> {};
+
+// Pointer type of the config, raw pointers for StdConfig
+template <typename Config, bool = IsStdConfig<Config>::value>
+struct PtrTraits {
+    template <typename Type>
+    using Ptr = Pointer<Type, Config>;
+
+    template <typename Type>
+    static Ptr<Type> pointerTo(Type& ref) { return Ptr<Type>::pointer_to(ref); }
+
+    template <typename Type>
+    static size_t bits(const Ptr<Type>& ptr) { return ptr.get(); }
+};
+
+template <typename Config>
+struct PtrTraits<Config, true> {
+    template <typename Type>
+    using Ptr = Type*;
+
+    template <typename Type>
+    static Type* pointerTo(Type& ref) { return &ref; }
+
+    template <typename Type>
+    static size_t bits(Type* ptr) { return reinterpret_cast<uintptr_t>(ptr); }
+};
+
+template <typename Config>
+struct Node {
+    typename PtrTraits<Config>::template Ptr<Node> next;
+    uint32_t value;
+};
+
+struct Case {
+    string config;
+    size_t index;
+    string location;
+    size_t nodes;
+    size_t ops;
+    uint32_t seed;
+};
+
+struct Result {
+    double chainNs = 0;
+    double derefNs = 0;
+    double pointerToNs = 0;
+    double allocateNs = 0;
+    double deallocateNs = 0;
+    size_t dummy = 0;
+};
+
+template <typename Func>
+double timeNs(size_t ops, Func func) {
+    auto start = Clock::now();
+    func();
+    return elapsedNs(start, Clock::now()) / double(ops);
+}
+
+// nodes are given by raw addresses, they are linked into a random cycle
+template <typename Config>
+void measureNodes(const Case& c, const vector<Node<Config>*>& nodes, Result& res) {
+    using Traits = PtrTraits<Config>;
+    using Ptr = typename Traits::template Ptr<Node<Config>>;
+    vector<Node<Config>*> order(nodes);
+    mt19937 rng(c.seed);
+    shuffle(order.begin(), order.end(), rng);
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i]->next = Traits::pointerTo(*order[(i + 1) % order.size()]);
+        order[i]->value = uint32_t(i);
+    }
+    vector<Ptr> ptrs;
+    for (Node<Config>* node : order) {
+        ptrs.push_back(Traits::pointerTo(*node));
+    }
+    size_t rounds = max<size_t>(1, c.ops / nodes.size());
+    size_t ops = rounds * nodes.size();
+    size_t sum = 0;
+
+    // dependent loads: every step needs the previous decoded pointer, shows latency
+    Ptr p = ptrs[0];
+    res.chainNs = timeNs(ops, [&] {
+        for (size_t i = 0; i < ops; ++i) {
+            p = p->next;
+        }
+    });
+    sum += p->value;
+
+    // independent loads: decoding of the next pointer doesn't depend on the previous one, shows throughput
+    res.derefNs = timeNs(ops, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (const Ptr& ptr : ptrs) {
+                sum += ptr->value;
+            }
+        }
+    });
+
+    res.pointerToNs = timeNs(ops, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (Node<Config>* node : order) {
+                sum += Traits::bits(Traits::pointerTo(*node));
+            }
+        }
+    });
+    res.dummy += sum;
+}
+
+template <typename Config>
+Result runArena(const Case& c) {
+    using NodeT = Node<Config>;
+    using Alloc = typename AllocFor<NodeT, Config>::type;
+    using Ptr = typename std::allocator_traits<Alloc>::pointer;
+    Result res;
+    ArenaScope<Config> scope(c.nodes + 1);
+    Alloc alloc;
+    vector<Ptr> ptrs(c.nodes);
+    size_t rounds = max<size_t>(1, c.ops / c.nodes);
+    double allocNs = 0;
+    double deallocNs = 0;
+    for (size_t r = 0; r < rounds; ++r) {
+        allocNs += timeNs(c.nodes, [&] {
+            for (Ptr& ptr : ptrs) {
+                ptr = alloc.allocate(1);
+            }
+        });
+        if (r + 1 == rounds) {
+            break;
+        }
+        deallocNs += timeNs(c.nodes, [&] {
+            for (Ptr& ptr : ptrs) {
+                alloc.deallocate(ptr, 1);
+            }
+        });
+    }
+    res.allocateNs = allocNs / double(rounds);
+    res.deallocateNs = (rounds > 1) ? deallocNs / double(rounds - 1) : 0;
+    vector<NodeT*> nodes;
+    for (Ptr& ptr : ptrs) {
+        nodes.push_back(::new (static_cast<void*>(&*ptr)) NodeT());
+    }
+    measureNodes<Config>(c, nodes, res);
+    for (Ptr& ptr : ptrs) {
+        alloc.deallocate(ptr, 1);
+    }
+    return res;
+}
+
+// runs in a new thread, so the nodes are close to the stack top as 16-bit index requires
+template <typename Config>
+void runStackThread(const Case& c, Result& res) {
+    ArenaScope<Config> scope(1);
+    array<Node<Config>, kMaxStackNodes> stackNodes;
+    escape(&stackNodes);
+    vector<Node<Config>*> nodes;
+    for (size_t i = 0; i < c.nodes; ++i) {
+        nodes.push_back(&stackNodes[i]);
+    }
+    measureNodes<Config>(c, nodes, res);
+}
+
+template <typename Config>
+Result runStack(const Case& c) {
+    Result res;
+    thread th([&c, &res] { runStackThread<Config>(c, res); });
+    th.join();
+    return res;
+}
+
+template <typename Config>
+void runCase(const Case& c, JsonWriter& json) {
+    Result res;
+    if (c.location == "arena") {
+        res = runArena<Config>(c);
+    } else if (c.location == "stack") {
+        if (c.nodes > kMaxStackNodes) {
+            cerr << "skip " << c.config << c.index << " stack: more than " << kMaxStackNodes << " nodes" << endl;
+            return;
+        }
+        res = runStack<Config>(c);
+    } else {
+        throw invalid_argument("unknown location " + c.location);
+    }
+    json.beginObject()
+        .field("config", c.config)
+        .field("index_bits", c.index)
+        .field("location", c.location)
+        .field("nodes", c.nodes)
+        .field("node_size", sizeof(Node<Config>))
+        .field("chain_deref_ns", res.chainNs)
+        .field("stream_deref_ns", res.derefNs)
+        .field("pointer_to_ns", res.pointerToNs);
+    if (c.location == "arena") {
+        json.field("allocate_ns", res.allocateNs).field("deallocate_ns", res.deallocateNs);
+    }
+    json.endObject();
+    if (res.dummy == 1) {
+        cerr << " ";
+    }
+}
+
+void runConfig(const Case& c, JsonWriter& json) {
+    if (c.config == "raw") {
+        runCase<StdConfig>(c, json);
+    } else if (c.config == "static" && c.index == 16) {
+        runCase<Static16>(c, json);
+    } else if (c.config == "static" && c.index == 32) {
+        runCase<Static32>(c, json);
+    } else if (c.config == "perthread" && c.index == 16) {
+        runCase<PerThread16>(c, json);
+    } else if (c.config == "perthread" && c.index == 32) {
+        runCase<PerThread32>(c, json);
+    } else if (c.config == "universal" && c.index == 16) {
+        runCase<Universal16>(c, json);
+    } else if (c.config == "universal" && c.index == 32) {
+        runCase<Universal32>(c, json);
+    } else if (c.config == "universal_perthread" && c.index == 16) {
+        runCase<UniversalPerThread16>(c, json);
+    } else if (c.config == "universal_perthread" && c.index == 32) {
+        runCase<UniversalPerThread32>(c, json);
+    } else {
+        throw invalid_argument("unknown config " + c.config + " or index " + to_string(c.index));
+    }
+}
+
+}
+
+int runPointer(const Options& options) {
+    Output output(options);
+    ostream& out = output.stream();
+    JsonWriter json(out);
+    Case c;
+    c.ops = options.num("ops", 10000000);
+    c.seed = uint32_t(options.num("seed", 1));
+    json.beginObject().field("benchmark", "pointer").field("ops", c.ops);
+    json.key("results").beginArray();
+    for (const string& config : options.list("config", "raw,static,perthread,universal,universal_perthread")) {
+        c.config = config;
+        for (size_t index : options.numList("index", "16,32")) {
+            c.index = (config == "raw") ? 64 : index;
+            for (const string& location : options.list("location", "arena,stack")) {
+                c.location = location;
+                for (size_t nodes : options.numList("nodes", "1024,4096")) {
+                    c.nodes = nodes;
+                    runConfig(c, json);
+                }
+            }
+            if (config == "raw") {
+                break;
+            }
+        }
+    }
+    json.endArray().endObject();
+    out << endl;
+    return 0;
+}
+
+}
@@ -0,0 +1,210 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchUtil.h"
+#include "ThreadUtil.h"
+#include "Workloads.h"
+
+#include <indexed/NewAlloc.h>
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/StatsArena.h>
+#include <indexed/RecordingArena.h>
+#include <indexed/SingleArenaConfig.h>
+
+#include <boost/container/map.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <new>
+#include <vector>
+
+using namespace std;
+using namespace indexed;
+
+namespace bench {
+
+namespace {
+
+using RecordedArena = RecordingArena<ArrayArena<uint32_t, NewAlloc>>;
+
+struct RecordConfig : public SingleArenaConfigStatic<RecordedArena, RecordConfig> {};
+
+constexpr size_t kMaxCapacity16 = (size_t(1) << 15) - 1;
+
+// random insert / erase in a map keeping at most live elements, recorded to fileName
+void recordDemo(const string& fileName, size_t live, size_t ops, uint32_t seed) {
+    using Alloc = typename AllocFor<pair<const uint32_t, uint32_t>, RecordConfig>::type;
+    using Map = boost::container::map<uint32_t, uint32_t, less<uint32_t>, Alloc>;
+    ArenaScope<RecordConfig> scope(live + 1);
+    scope.arena()->startRecording(fileName);
+    {
+        Map map;
+        escape(&map);
+        vector<uint32_t> keys;
+        XorShift rng(seed);
+        uint32_t nextKey = 0;
+        for (size_t k = 0; k < ops; ++k) {
+            // the live set grows to the limit and shrinks back, to have a peak and free slots after it
+            size_t limit = (k % (ops / 4 + 1) < ops / 8) ? live : live / 4;
+            if (keys.empty() || (keys.size() < limit && (rng.next() & 3) != 0)) {
+                keys.push_back(nextKey);
+                map.emplace(nextKey, nextKey);
+                ++nextKey;
+            } else {
+                size_t pos = rng.next() % keys.size();
+                map.erase(keys[pos]);
+                keys[pos] = keys.back();
+                keys.pop_back();
+            }
+        }
+    }
+    scope.arena()->stopRecording();
+}
+
+struct Variant {
+    size_t indexSize;
+    bool enableDelete;
+    bool mt;
+};
+
+Variant parseVariant(const string& name) {
+    if (name == "lifo16") {
+        return Variant{2, true, false};
+    } else if (name == "lifo32") {
+        return Variant{4, true, false};
+    } else if (name == "nodelete32") {
+        return Variant{4, false, false};
+    } else if (name == "mt32") {
+        return Variant{4, true, true};
+    }
+    throw invalid_argument("unknown arena " + name);
+}
+
+struct ReplayResult {
+    size_t elementSize = 0;
+    size_t events = 0;
+    size_t peakLive = 0;
+    double maxFragmentation = 0;
+    double ns = 0;
+    ArenaStats stats;
+};
+
+// replays the events of one object size, recorded indices are mapped to the indices of the Arena
+template <typename Arena>
+ReplayResult replaySizeClass(const vector<ArenaTraceEvent>& events, size_t size, size_t capacity, bool enableDelete) {
+    using Index = typename Arena::IndexType;
+    constexpr size_t kSampleEvents = 1024;
+    ReplayResult res;
+    res.elementSize = (size + sizeof(Index) - 1) / sizeof(Index) * sizeof(Index);
+    uint32_t maxIndex = 0;
+    for (const ArenaTraceEvent& event : events) {
+        maxIndex = max(maxIndex, event.index);
+    }
+    vector<Index> mapping(size_t(maxIndex) + 1, 0);
+    StatsArena<Arena> arena(capacity, enableDelete);
+    size_t live = 0;
+    auto start = Clock::now();
+    for (const ArenaTraceEvent& event : events) {
+        if (event.size() != size) {
+            continue;
+        }
+        ++res.events;
+        if (event.op() == ArenaTraceOp::Allocate) {
+            try {
+                mapping[event.index] = arena.allocate(res.elementSize);
+                res.peakLive = max(res.peakLive, ++live);
+            } catch (const bad_alloc&) {
+                mapping[event.index] = 0;
+            }
+        } else if (event.op() == ArenaTraceOp::Deallocate && mapping[event.index] != 0) {
+            arena.deallocate(mapping[event.index], res.elementSize);
+            mapping[event.index] = 0;
+            --live;
+        }
+        if (res.events % kSampleEvents == 0) {
+            res.maxFragmentation = max(res.maxFragmentation, arena.stats().fragmentation);
+        }
+    }
+    res.ns = elapsedNs(start, Clock::now());
+    res.stats = arena.stats();
+    res.maxFragmentation = max(res.maxFragmentation, res.stats.fragmentation);
+    return res;
+}
+
+ReplayResult runVariant(const Variant& v, const vector<ArenaTraceEvent>& events, size_t size, size_t capacity) {
+    if (v.indexSize == 2) {
+        return replaySizeClass<ArrayArena<uint16_t, NewAlloc>>(events, size, capacity, v.enableDelete);
+    } else if (v.mt) {
+        return replaySizeClass<ArrayArenaMT<uint32_t, NewAlloc>>(events, size, capacity, v.enableDelete);
+    }
+    return replaySizeClass<ArrayArena<uint32_t, NewAlloc>>(events, size, capacity, v.enableDelete);
+}
+
+}
+
+int runReplay(const Options& options) {
+    Output output(options);
+    ostream& out = output.stream();
+    JsonWriter json(out);
+    string traceFile = options.str("trace", "");
+    if (traceFile.empty()) {
+        traceFile = options.str("record", "arena.trace");
+        recordDemo(traceFile, options.num("live", 10000), options.num("ops", 1000000), uint32_t(options.num("seed", 1)));
+    }
+    ArenaTraceHeader header;
+    vector<ArenaTraceEvent> events = readArenaTrace(traceFile, header);
+    // size classes: every object size gets its own Arena, as ArrayArena allocates objects of one size
+    std::map<size_t, size_t> sizeEvents;
+    size_t recordedBadAllocs = 0;
+    for (const ArenaTraceEvent& event : events) {
+        ++sizeEvents[event.size()];
+        recordedBadAllocs += (event.op() == ArenaTraceOp::BadAlloc);
+    }
+    size_t capacity = options.num("capacity", size_t(header.capacity));
+    double headroom = stod(options.str("headroom", "1.25"));
+    json.beginObject()
+        .field("benchmark", "replay")
+        .field("trace", traceFile)
+        .field("events", events.size())
+        .field("recorded_index_size", size_t(header.indexSize))
+        .field("recorded_capacity", size_t(header.capacity))
+        .field("recorded_bad_allocs", recordedBadAllocs)
+        .field("capacity", capacity);
+    json.key("results").beginArray();
+    for (const auto& sizeClass : sizeEvents) {
+        for (const string& name : options.list("arena", "lifo16,lifo32,nodelete32,mt32")) {
+            Variant v = parseVariant(name);
+            size_t variantCapacity = (v.indexSize == 2) ? min(capacity, kMaxCapacity16) : capacity;
+            ReplayResult res = runVariant(v, events, sizeClass.first, variantCapacity);
+            size_t recommended = size_t(ceil(double(res.stats.highWaterMark) * headroom));
+            json.beginObject()
+                .field("arena", name)
+                .field("object_size", sizeClass.first)
+                .field("element_size", res.elementSize)
+                .field("events", res.events)
+                .field("capacity", variantCapacity)
+                .field("bad_allocs", res.stats.badAllocCount)
+                .field("peak_live", res.peakLive)
+                .field("required_capacity", res.stats.highWaterMark)
+                .field("recommended_capacity", recommended)
+                .field("recommended_bytes", recommended * res.elementSize)
+                .field("fits_index", v.indexSize == 4 || recommended <= kMaxCapacity16)
+                .field("final_fragmentation", res.stats.fragmentation)
+                .field("max_fragmentation", res.maxFragmentation)
+                .field("ns_per_event", res.events ? res.ns / double(res.events) : 0.0)
+                .endObject();
+        }
+    }
+    json.endArray().endObject();
+    out << endl;
+    return 0;
+}
+
+}
@@ -0,0 +1,257 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchUtil.h"
+#include "Baselines.h"
+#include "PerfCounters.h"
+#include "Workloads.h"
+
+#include <indexed/NewAlloc.h>
+#include <indexed/ArrayArena.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+
+#include <iostream>
+#include <cstdint>
+#include <memory>
+
+using namespace std;
+using namespace indexed;
+
+namespace bench {
+
+namespace {
+
+constexpr size_t kBatchSize = 64;
+
+template <typename Index>
+using Arena = ArrayArena<Index, NewAlloc>;
+
+struct ConfigStatic16 : public SingleArenaConfigStatic<Arena<uint16_t>, ConfigStatic16> {};
+struct ConfigStatic32 : public SingleArenaConfigStatic<Arena<uint32_t>, ConfigStatic32> {};
+struct ConfigUniversal16 : public SingleArenaConfigUniversalStatic<Arena<uint16_t>, ConfigUniversal16> {};
+struct ConfigUniversal32 : public SingleArenaConfigUniversalStatic<Arena<uint32_t>, ConfigUniversal32> {};
+
+struct Case {
+    string container;
+    string config;
+    size_t index;
+    size_t payload;
+    string dist;
+    size_t size;
+};
+
+struct Params {
+    size_t ops;
+    size_t repeat;
+    uint32_t seed;
+    JsonWriter* json;
+    PerfCounters* perf; // nullptr if counters are off
+};
+
+struct OpResult {
+    Samples samples;
+    vector<double> counters;
+};
+
+// NOTE the counters include the clock reads done once per batch
+template <typename Op>
+void measure(OpResult& result, const vector<uint32_t>& keys, PerfCounters* perf, Op op) {
+    if (perf) {
+        perf->start();
+    }
+    for (size_t pos = 0; pos < keys.size(); pos += kBatchSize) {
+        size_t end = min(keys.size(), pos + kBatchSize);
+        auto start = Clock::now();
+        for (size_t i = pos; i < end; ++i) {
+            op(keys[i]);
+        }
+        result.samples.add(elapsedNs(start, Clock::now()), end - pos);
+    }
+    if (perf) {
+        perf->stop(result.counters);
+    }
+}
+
+void writeResult(const Case& c, const Params& params, const char operation[], OpResult& result) {
+    Samples& samples = result.samples;
+    JsonWriter& json = *params.json;
+    json.beginObject()
+        .field("container", c.container)
+        .field("config", c.config)
+        .field("index_bits", c.index)
+        .field("payload_bytes", c.payload)
+        .field("distribution", c.dist)
+        .field("size", c.size)
+        .field("operation", operation)
+        .field("ops", samples.ops());
+    json.key("ns_per_op");
+    writeSamples(json, samples);
+    if (params.perf) {
+        json.key("counters_per_op").beginObject();
+        for (size_t i = 0; i < result.counters.size(); ++i) {
+            json.field(params.perf->name(i), result.counters[i] / double(samples.ops()));
+        }
+        json.endObject();
+    }
+    json.endObject();
+}
+
+template <typename Workload, typename Config>
+void runCase(const Case& c, const Params& params) {
+    if (c.size + 2 > maxCapacity<Config>()) {
+        cerr << "skip " << c.container << " " << c.config << c.index << " size " << c.size
+             << ": too many Nodes for the index type" << endl;
+        return;
+    }
+    vector<uint32_t> insertKeys = makeInsertKeys(c.dist, c.size, params.seed);
+    vector<uint32_t> queryKeys = makeQueryKeys(c.dist, c.size, params.ops, params.seed + 1);
+    vector<uint32_t> eraseKeys = makeInsertKeys(c.dist, c.size, params.seed + 2);
+    OpResult insertResult;
+    OpResult queryResult;
+    OpResult eraseResult;
+    PerfCounters* perf = params.perf;
+    uint32_t dummy = 0;
+    for (size_t k = 0; k < params.repeat; ++k) {
+        ArenaScope<Config> scope(c.size + 2); // unordered map allocates one extra Node
+        Workload workload;
+        measure(insertResult, insertKeys, perf, [&workload](uint32_t key) { workload.insert(key); });
+        measure(queryResult, queryKeys, perf, [&workload, &dummy](uint32_t key) { dummy += workload.query(key); });
+        measure(eraseResult, eraseKeys, perf, [&workload](uint32_t key) { workload.erase(key); });
+    }
+    writeResult(c, params, "insert", insertResult);
+    writeResult(c, params, "query", queryResult);
+    writeResult(c, params, "erase", eraseResult);
+    if (dummy == 1) {
+        cerr << " ";
+    }
+}
+
+template <typename Config, size_t kSize>
+void runContainers(Case c, const Options& options, const Params& params) {
+    using W = Workloads<Config, kSize>;
+    for (const string& container : options.list("containers", "list,slist,set,map,unordered,intrusive")) {
+        c.container = container;
+        for (const string& dist : options.list("dist", "seq,uniform,zipf")) {
+            c.dist = dist;
+            for (size_t size : options.numList("size", "1000,10000,100000")) {
+                c.size = size;
+                if (container == "list") {
+                    runCase<typename W::List, Config>(c, params);
+                } else if (container == "slist") {
+                    runCase<typename W::SList, Config>(c, params);
+                } else if (container == "set") {
+                    runCase<typename W::Set, Config>(c, params);
+                } else if (container == "map") {
+                    runCase<typename W::Map, Config>(c, params);
+                } else if (container == "unordered") {
+                    runCase<typename W::UnMap, Config>(c, params);
+                } else if (container == "intrusive") {
+                    runCase<typename W::Intrusive, Config>(c, params);
+                } else {
+                    throw invalid_argument("unknown container " + container);
+                }
+            }
+        }
+    }
+}
+
+template <typename Config>
+void runPayloads(Case c, const Options& options, const Params& params) {
+    for (size_t payload : options.numList("payload", "4,16,64")) {
+        c.payload = payload;
+        switch (payload) {
+        case 4:
+            runContainers<Config, 4>(c, options, params);
+            break;
+        case 16:
+            runContainers<Config, 16>(c, options, params);
+            break;
+        case 64:
+            runContainers<Config, 64>(c, options, params);
+            break;
+        default:
+            throw invalid_argument("payload must be 4, 16 or 64");
+        }
+    }
+}
+
+// containers with full-size pointers, true if config is one of them
+bool runBaseline(Case c, const Options& options, const Params& params) {
+    c.index = 64;
+    if (c.config == "std") {
+        runPayloads<StdConfig>(c, options, params);
+    } else if (c.config == "bump") {
+        runPayloads<BumpConfig>(c, options, params);
+    } else if (c.config == "boost_pool") {
+        runPayloads<BoostPoolConfig>(c, options, params);
+    } else if (c.config == "boost_fast_pool") {
+        runPayloads<BoostFastPoolConfig>(c, options, params);
+#if BENCH_HAS_PMR == 1
+    } else if (c.config == "pmr_pool") {
+        runPayloads<PmrPoolConfig>(c, options, params);
+    } else if (c.config == "pmr_sync_pool") {
+        runPayloads<PmrSyncPoolConfig>(c, options, params);
+#endif
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void runConfigs(const Options& options, const Params& params) {
+    Case c;
+    for (const string& config : options.list("config", "static,universal,std")) {
+        c.config = config;
+        if (runBaseline(c, options, params)) {
+            continue;
+        }
+        for (size_t index : options.numList("index", "16,32")) {
+            c.index = index;
+            if (config == "static" && index == 16) {
+                runPayloads<ConfigStatic16>(c, options, params);
+            } else if (config == "static" && index == 32) {
+                runPayloads<ConfigStatic32>(c, options, params);
+            } else if (config == "universal" && index == 16) {
+                runPayloads<ConfigUniversal16>(c, options, params);
+            } else if (config == "universal" && index == 32) {
+                runPayloads<ConfigUniversal32>(c, options, params);
+            } else {
+                throw invalid_argument("unknown config " + config + " or index " + to_string(index));
+            }
+        }
+    }
+}
+
+}
+
+int runSuite(const Options& options) {
+    Output output(options);
+    ostream& out = output.stream();
+    JsonWriter json(out);
+    unique_ptr<PerfCounters> perf;
+    if (options.has("perf")) {
+        perf.reset(new PerfCounters());
+        if (!perf->available()) {
+            cerr << "perf counters are not available, check /proc/sys/kernel/perf_event_paranoid" << endl;
+            perf.reset();
+        }
+    }
+    Params params = {options.num("ops", 100000), options.num("repeat", 3),
+                     uint32_t(options.num("seed", 1)), &json, perf.get()};
+    json.beginObject()
+        .field("benchmark", "suite")
+        .field("repeat", params.repeat)
+        .field("batch", kBatchSize)
+        .field("perf_counters", perf != nullptr);
+    json.key("results").beginArray();
+    runConfigs(options, params);
+    json.endArray().endObject();
+    out << endl;
+    return 0;
+}
+
+}
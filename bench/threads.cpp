@@ -0,0 +1,352 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include "BenchUtil.h"
+#include "ThreadUtil.h"
+
+#include <indexed/NewAlloc.h>
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/InboxArena.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace indexed;
+
+namespace bench {
+
+namespace {
+
+using Arena = ArrayArena<uint32_t, NewAlloc>;
+using ArenaMT = ArrayArenaMT<uint32_t, NewAlloc>;
+using ArenaInbox = InboxArena<Arena>;
+
+constexpr size_t kHandoffCapacity = 1024;
+
+struct Params {
+    size_t threads;
+    size_t elementSize;
+    size_t live;
+    size_t ops;
+    double allocRatio;
+    double crossRatio;
+};
+
+// one shared ArrayArenaMT, any thread can free any block
+class SharedArenaBackend {
+public:
+    static constexpr bool kCrossFree = true;
+
+    explicit SharedArenaBackend(const Params& params)
+    : m_arena(params.threads * (params.live + kHandoffCapacity) + 1)
+    , m_elementSize(params.elementSize) {}
+
+    struct Local {
+        explicit Local(SharedArenaBackend& backend)
+        : m_backend(backend) {}
+
+        uint64_t allocate() {
+            uint32_t index = m_backend.m_arena.allocate(m_backend.m_elementSize);
+            memset(m_backend.m_arena.getElement(index), 1, m_backend.m_elementSize);
+            return index;
+        }
+
+        void deallocate(uint64_t block) { m_backend.m_arena.deallocate(uint32_t(block), m_backend.m_elementSize); }
+
+        SharedArenaBackend& m_backend;
+    };
+
+    size_t casRetries() const { return m_arena.casRetryCount(); }
+
+private:
+    ArenaMT m_arena;
+    size_t m_elementSize;
+};
+
+// ArrayArena per thread (as with SingleArenaConfigPerThread), blocks must be freed by the owner
+class ThreadArenaBackend {
+public:
+    static constexpr bool kCrossFree = false;
+
+    explicit ThreadArenaBackend(const Params& params)
+    : m_params(params) {}
+
+    struct Local {
+        explicit Local(ThreadArenaBackend& backend)
+        : m_arena(backend.m_params.live + 1)
+        , m_elementSize(backend.m_params.elementSize) {}
+
+        uint64_t allocate() {
+            uint32_t index = m_arena.allocate(m_elementSize);
+            memset(m_arena.getElement(index), 1, m_elementSize);
+            return index;
+        }
+
+        void deallocate(uint64_t block) { m_arena.deallocate(uint32_t(block), m_elementSize); }
+
+        Arena m_arena;
+        size_t m_elementSize;
+    };
+
+    size_t casRetries() const { return 0; }
+
+private:
+    Params m_params;
+};
+
+// ArrayArena per thread with the inbox for blocks freed by other threads, a block keeps the owner number
+class InboxArenaBackend {
+public:
+    static constexpr bool kCrossFree = true;
+
+    explicit InboxArenaBackend(const Params& params)
+    : m_nextOwner(0)
+    , m_elementSize(params.elementSize) {
+        for (size_t i = 0; i < params.threads; ++i) {
+            m_arenas.emplace_back(new ArenaInbox(params.live + kHandoffCapacity + 1));
+        }
+    }
+
+    struct Local {
+        explicit Local(InboxArenaBackend& backend)
+        : m_backend(backend)
+        , m_owner(backend.m_nextOwner++)
+        , m_arena(*backend.m_arenas[m_owner]) {
+            m_arena.setOwnerThread();
+        }
+
+        uint64_t allocate() {
+            uint32_t index = m_arena.allocate(m_backend.m_elementSize);
+            memset(m_arena.getElement(index), 1, m_backend.m_elementSize);
+            return (uint64_t(m_owner) << 32) | index;
+        }
+
+        void deallocate(uint64_t block) {
+            m_backend.m_arenas[block >> 32]->deallocate(uint32_t(block), m_backend.m_elementSize);
+        }
+
+        InboxArenaBackend& m_backend;
+        size_t m_owner;
+        ArenaInbox& m_arena;
+    };
+
+    size_t casRetries() const { return 0; }
+
+private:
+    vector<unique_ptr<ArenaInbox>> m_arenas;
+    atomic<size_t> m_nextOwner;
+    size_t m_elementSize;
+};
+
+class MallocBackend {
+public:
+    static constexpr bool kCrossFree = true;
+
+    explicit MallocBackend(const Params& params)
+    : m_elementSize(params.elementSize) {}
+
+    struct Local {
+        explicit Local(MallocBackend& backend)
+        : m_elementSize(backend.m_elementSize) {}
+
+        uint64_t allocate() {
+            void* ptr = malloc(m_elementSize);
+            if (!ptr) {
+                throw bad_alloc();
+            }
+            memset(ptr, 1, m_elementSize);
+            return reinterpret_cast<uintptr_t>(ptr);
+        }
+
+        void deallocate(uint64_t block) { free(reinterpret_cast<void*>(uintptr_t(block))); }
+
+        size_t m_elementSize;
+    };
+
+    size_t casRetries() const { return 0; }
+
+private:
+    size_t m_elementSize;
+};
+
+struct RunResult {
+    double seconds;
+    size_t ops;
+    size_t crossFrees;
+    size_t casRetries;
+};
+
+// Thread i keeps up to live blocks, allocates with allocRatio probability and frees a random block
+// otherwise. A freed block goes to thread i + 1 with crossRatio probability, the receiver frees it.
+template <typename Backend>
+RunResult runSweep(const Params& params) {
+    Backend backend(params);
+    vector<unique_ptr<Handoff<uint64_t>>> inboxes;
+    for (size_t i = 0; i < params.threads; ++i) {
+        inboxes.emplace_back(new Handoff<uint64_t>(kHandoffCapacity));
+    }
+    vector<atomic<bool>> done(params.threads);
+    vector<size_t> ops(params.threads, 0);
+    vector<size_t> crossFrees(params.threads, 0);
+    StartBarrier barrier(params.threads);
+    double crossRatio = Backend::kCrossFree ? params.crossRatio : 0;
+
+    vector<thread> threads;
+    for (size_t t = 0; t < params.threads; ++t) {
+        done[t] = false;
+        threads.emplace_back([&, t] {
+            pinThread(t);
+            typename Backend::Local local(backend);
+            Handoff<uint64_t>& inbox = *inboxes[t];
+            Handoff<uint64_t>& outbox = *inboxes[(t + 1) % params.threads];
+            const size_t prevThread = (t + params.threads - 1) % params.threads;
+            vector<uint64_t> live;
+            live.reserve(params.live);
+            XorShift rng(t + 1);
+            size_t count = 0;
+            barrier.wait();
+            for (size_t k = 0; k < params.ops; ++k) {
+                uint64_t block = 0;
+                while (inbox.pop(block)) {
+                    local.deallocate(block);
+                    ++count;
+                }
+                if (live.empty() || (live.size() < params.live && rng.uniform() < params.allocRatio)) {
+                    live.push_back(local.allocate());
+                } else {
+                    size_t pos = rng.next() % live.size();
+                    block = live[pos];
+                    live[pos] = live.back();
+                    live.pop_back();
+                    if (crossRatio > 0 && rng.uniform() < crossRatio && outbox.push(block)) {
+                        ++crossFrees[t];
+                        continue;
+                    }
+                    local.deallocate(block);
+                }
+                ++count;
+            }
+            for (uint64_t block : live) {
+                local.deallocate(block);
+            }
+            done[t] = true;
+            uint64_t block = 0;
+            for (bool prevDone = false; ;) {
+                while (inbox.pop(block)) {
+                    local.deallocate(block);
+                }
+                if (prevDone) {
+                    break;
+                }
+                prevDone = done[prevThread];
+            }
+            ops[t] = count;
+        });
+    }
+    for (thread& th : threads) {
+        th.join();
+    }
+    RunResult res;
+    res.seconds = barrier.elapsedSeconds();
+    res.ops = 0;
+    res.crossFrees = 0;
+    for (size_t t = 0; t < params.threads; ++t) {
+        res.ops += ops[t];
+        res.crossFrees += crossFrees[t];
+    }
+    res.casRetries = backend.casRetries();
+    return res;
+}
+
+RunResult runBackend(const string& arena, const Params& params) {
+    if (arena == "mt") {
+        return runSweep<SharedArenaBackend>(params);
+    } else if (arena == "tl") {
+        return runSweep<ThreadArenaBackend>(params);
+    } else if (arena == "tl-inbox") {
+        return runSweep<InboxArenaBackend>(params);
+    } else if (arena == "malloc") {
+        return runSweep<MallocBackend>(params);
+    }
+    throw invalid_argument("unknown arena " + arena);
+}
+
+string defaultThreadList() {
+    size_t maxThreads = max<size_t>(1, thread::hardware_concurrency());
+    string res;
+    for (size_t n = 1; ; n *= 2) {
+        n = min(n, maxThreads);
+        res += (res.empty() ? "" : ",") + to_string(n);
+        if (n == maxThreads) {
+            break;
+        }
+    }
+    return res;
+}
+
+}
+
+int runThreads(const Options& options) {
+    Output output(options);
+    ostream& out = output.stream();
+    JsonWriter json(out);
+    Params params;
+    params.elementSize = options.num("element", 32);
+    params.live = options.num("live", 1024);
+    params.ops = options.num("ops", 1000000);
+    json.beginObject()
+        .field("benchmark", "threads")
+        .field("element_size", params.elementSize)
+        .field("live_per_thread", params.live)
+        .field("ops_per_thread", params.ops)
+        .field("cas_stats", bool(INDEXED_CAS_STATS));
+    json.key("results").beginArray();
+    for (const string& arena : options.list("arena", "mt,tl,tl-inbox,malloc")) {
+        for (const string& allocRatio : options.list("alloc-ratio", "0.5,0.8")) {
+            for (const string& crossRatio : options.list("cross-ratio", "0,0.5")) {
+                params.allocRatio = stod(allocRatio);
+                params.crossRatio = stod(crossRatio);
+                if (arena == "tl" && params.crossRatio > 0) {
+                    continue; // per thread Arena doesn't support cross-thread free
+                }
+                double singleThroughput = 0; // per thread, for the first thread count
+                for (size_t threads : options.numList("threads", defaultThreadList())) {
+                    params.threads = threads;
+                    RunResult res = runBackend(arena, params);
+                    double throughput = double(res.ops) / res.seconds;
+                    if (singleThroughput == 0) {
+                        singleThroughput = throughput / double(threads);
+                    }
+                    json.beginObject()
+                        .field("arena", arena)
+                        .field("alloc_ratio", params.allocRatio)
+                        .field("cross_ratio", params.crossRatio)
+                        .field("threads", threads)
+                        .field("ops", res.ops)
+                        .field("seconds", res.seconds)
+                        .field("mops_per_sec", throughput / 1e6)
+                        .field("efficiency", throughput / (singleThroughput * double(threads)))
+                        .field("cross_frees", res.crossFrees)
+                        .field("cas_retries", res.casRetries)
+                        .field("cas_retries_per_1k_ops", 1e3 * double(res.casRetries) / double(res.ops))
+                        .endObject();
+                }
+            }
+        }
+    }
+    json.endArray().endObject();
+    out << endl;
+    return 0;
+}
+
+}
@@ -0,0 +1,58 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ContainerTraits.h>
+
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace indexed {
+
+namespace detail {
+
+template <typename Container>
+void destroyElements(Container&, std::true_type) noexcept {}
+
+// only the elements are destroyed, the Nodes aren't unlinked or deallocated
+template <typename Container>
+void destroyElements(Container& container, std::false_type) noexcept {
+    using Element = typename Container::value_type;
+    for (auto it = container.begin(); it != container.end(); ++it) {
+        const Element* element = std::addressof(*it);
+        element->~Element();
+    }
+}
+
+}
+
+/**
+* @brief Empty the Container and drop all objects of its Arena at once, instead of container = Container().
+*
+* The Container object is recreated in place with its Allocator, the old one isn't destructed, so the Nodes
+* aren't unlinked and deallocated one by one, then Arena::discard() forgets them all in O(1).
+* For trivially destructible elements the whole operation is O(1), otherwise the elements are destructed
+* in one pass over the Container first (no rebalancing, no free list). The Arena must hold only
+* the Nodes of this Container, e.g. a per-request Arena. boost::unordered containers aren't supported,
+* their bucket array isn't in the Arena.
+* @param container the Container, it's empty afterwards
+* @param arena its Arena
+*/
+template <typename Container, typename Arena>
+void abandon(Container& container, Arena& arena) noexcept {
+    static_assert(!detail::IsUnorderedContainer<Container>::value,
+                  "indexed::abandon() doesn't support unordered containers, their buckets aren't in the Arena");
+    detail::destroyElements(container,
+                            std::integral_constant<bool, std::is_trivially_destructible<typename Container::value_type>::value>());
+    typename Container::allocator_type alloc = container.get_allocator();
+    ::new (static_cast<void*>(std::addressof(container))) Container(alloc);
+    arena.discard();
+}
+
+}
@@ -0,0 +1,191 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArenaSnapshot.h>
+#include <indexed/DirtyArena.h>
+
+#ifdef WIN32
+#error "indexed::ArenaCheckpoint requires POSIX file descriptors"
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace indexed {
+
+/**
+* @brief Header of a delta made by saveDelta(), followed by the Container bytes, the chunk records
+* (uint64_t offset, uint64_t size, bytes) and the uint64_t checksum of all of them including the header.
+*/
+struct ArenaDeltaHeader {
+    static constexpr uint32_t kVersion = 1;
+
+    char magic[8];            // "IDXDELTA"
+    uint32_t version;
+    uint32_t headerSize;      // sizeof(ArenaDeltaHeader)
+    ArenaMetadata arena;      // state of the Arena when the delta is saved
+    uint64_t containerSize;
+    uint64_t chunkCount;
+};
+
+namespace detail {
+
+inline void checkDeltaHeader(const ArenaDeltaHeader& header) {
+    if (std::memcmp(header.magic, "IDXDELTA", sizeof(header.magic)) != 0
+        || header.headerSize != sizeof(ArenaDeltaHeader)) {
+        throw std::runtime_error("indexed::ArenaDelta data isn't a delta");
+    }
+    if (header.version != ArenaDeltaHeader::kVersion) {
+        throw std::runtime_error("indexed::ArenaDelta version isn't supported");
+    }
+    // bounds capacity and elementSize, so the data size of the delta can't overflow
+    try {
+        checkSavedArenaMetadata(header.arena);
+    } catch (const std::invalid_argument&) {
+        throw std::runtime_error("indexed::ArenaDelta delta is corrupted");
+    }
+}
+
+// reads and checksums
+inline void readChecked(int fd, void* data, size_t size, SnapshotChecksum& checksum) {
+    readFull(fd, data, size);
+    checksum.update(data, size);
+}
+
+// writes the delta of the DirtyArena via write(data, size) and clears the chunks
+template <typename Arena, typename Writer>
+size_t writeDelta(Arena& arena, const void* container, size_t containerSize, Writer&& write) {
+    ArenaDeltaHeader header = ArenaDeltaHeader();
+    std::memcpy(header.magic, "IDXDELTA", sizeof(header.magic));
+    header.version = ArenaDeltaHeader::kVersion;
+    header.headerSize = sizeof(ArenaDeltaHeader);
+    header.arena = arena.metadata();
+    header.containerSize = containerSize;
+    header.chunkCount = arena.collectDirty();
+
+    SnapshotChecksum checksum;
+    auto writeChecked = [&](const void* data, size_t size) {
+        checksum.update(data, size);
+        write(data, size);
+    };
+    writeChecked(&header, sizeof(header));
+    writeChecked(container, containerSize);
+    arena.forEachDirtyChunk([&](size_t offset, size_t size) {
+        uint64_t record[2] = {offset, size};
+        writeChecked(record, sizeof(record));
+        writeChecked(arena.begin() + offset, size);
+    });
+    uint64_t sum = checksum.value();
+    write(&sum, sizeof(sum));
+    arena.clearDirty();
+    return size_t(header.chunkCount);
+}
+
+}
+
+/**
+* @brief Save the Arena chunks modified since the last clearDirty() and the Container object, then clear them.
+*
+* Save a base with saveSnapshot() and call arena.clearDirty() after it, then saveDelta() periodically.
+* compactSnapshot() merges the base and the deltas into a new snapshot, load it with loadSnapshot().
+* The requirements for the Container are the ones of saveSnapshot().
+* NOTE Nobody may modify the Arena or the Container meanwhile.
+* @param arena DirtyArena
+* @param container the Container object
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+* @param fd file descriptor to write the delta to
+* @return number of saved chunks
+*/
+template <typename Arena>
+size_t saveDelta(Arena& arena, const void* container, size_t containerSize, int fd) {
+    return detail::writeDelta(arena, container, containerSize, [fd](const void* data, size_t size) {
+        detail::writeFull(fd, data, size);
+    });
+}
+
+/**
+* @brief Merge a snapshot and the deltas saved after it, in order, into a new snapshot.
+* The whole Arena image is kept in memory meanwhile. Throws std::runtime_error if a file is corrupted.
+* @param baseFd file descriptor of the snapshot made by saveSnapshot()
+* @param deltaFds file descriptors of the deltas made by saveDelta()
+* @param outFd file descriptor to write the new snapshot to, it can be loaded with loadSnapshot()
+*/
+inline void compactSnapshot(int baseFd, const std::vector<int>& deltaFds, int outFd) {
+    ArenaSnapshotHeader base;
+    detail::readFull(baseFd, &base, sizeof(base));
+    detail::checkSnapshotHeader(base, size_t(base.containerSize));
+    detail::SnapshotChecksum baseChecksum;
+    uint64_t stored = detail::headerChecksum(base, baseChecksum);
+    ArenaMetadata meta = base.arena;
+    std::vector<char> container(size_t(base.containerSize));
+    detail::readChecked(baseFd, container.data(), container.size(), baseChecksum);
+    char padding[ArenaSnapshotHeader::kDataAlignment] = {};
+    detail::readFull(baseFd, padding, detail::snapshotPaddingSize(base));
+    std::vector<char> data(size_t(base.dataSize));
+    detail::readChecked(baseFd, data.data(), data.size(), baseChecksum);
+    if (baseChecksum.value() != stored) {
+        throw std::runtime_error("indexed::compactSnapshot snapshot checksum mismatch");
+    }
+
+    for (int fd : deltaFds) {
+        ArenaDeltaHeader delta;
+        detail::SnapshotChecksum checksum;
+        detail::readChecked(fd, &delta, sizeof(delta), checksum);
+        detail::checkDeltaHeader(delta);
+        if (delta.containerSize != container.size()
+            || (meta.elementSize != 0 && delta.arena.elementSize != 0 && delta.arena.elementSize != meta.elementSize)) {
+            throw std::runtime_error("indexed::compactSnapshot delta doesn't match the snapshot");
+        }
+        std::vector<char> deltaContainer(container.size());
+        detail::readChecked(fd, deltaContainer.data(), deltaContainer.size(), checksum);
+        // the chunks are staged until the checksum is verified, so a corrupted delta doesn't change the image
+        size_t dataSize = size_t(delta.arena.usedCapacity * delta.arena.elementSize);
+        std::vector<uint64_t> records;
+        std::vector<char> chunks;
+        for (uint64_t i = 0; i < delta.chunkCount; ++i) {
+            uint64_t record[2];
+            detail::readChecked(fd, record, sizeof(record), checksum);
+            if (record[0] > dataSize || record[1] > dataSize - record[0]) {
+                throw std::runtime_error("indexed::compactSnapshot delta is corrupted");
+            }
+            records.insert(records.end(), record, record + 2);
+            chunks.resize(chunks.size() + size_t(record[1]));
+            detail::readChecked(fd, chunks.data() + chunks.size() - record[1], size_t(record[1]), checksum);
+        }
+        uint64_t sum;
+        detail::readFull(fd, &sum, sizeof(sum));
+        if (sum != checksum.value()) {
+            throw std::runtime_error("indexed::compactSnapshot delta checksum mismatch");
+        }
+        meta = delta.arena;
+        container.swap(deltaContainer);
+        data.resize(dataSize);
+        const char* chunk = chunks.data();
+        for (size_t i = 0; i < records.size(); i += 2) {
+            std::memcpy(data.data() + records[i], chunk, size_t(records[i + 1]));
+            chunk += records[i + 1];
+        }
+    }
+
+    ArenaSnapshotHeader header = detail::makeSnapshotHeader(meta, container.size());
+    detail::SnapshotChecksum checksum;
+    detail::headerChecksum(header, checksum);
+    checksum.update(container.data(), container.size());
+    checksum.update(data.data(), data.size());
+    header.checksum = checksum.value();
+    detail::writeFull(outFd, &header, sizeof(header));
+    detail::writeFull(outFd, container.data(), container.size());
+    std::memset(padding, 0, sizeof(padding));
+    detail::writeFull(outFd, padding, detail::snapshotPaddingSize(header));
+    detail::writeFull(outFd, data.data(), data.size());
+}
+
+}
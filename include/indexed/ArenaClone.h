@@ -0,0 +1,69 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArenaMetadata.h>
+#include <indexed/Parallel.h>
+
+#include <cstring>
+
+namespace indexed {
+
+namespace detail {
+
+// memcpy split into cache line aligned parts, one per thread
+inline void parallelCopy(void* to, const void* from, size_t size, unsigned threads) {
+    parallelFor(size, threads, size_t(1) << 20, 64, [to, from](size_t begin, size_t end) {
+        std::memcpy(static_cast<char*>(to) + begin, static_cast<const char*>(from) + begin, end - begin);
+    });
+}
+
+}
+
+/**
+* @brief Clone the Arena: copy its objects and adopt its capacity, element size and free list.
+*
+* The objects are copied with memcpy of usedCapacity elements, so it's bound by memory bandwidth,
+* not by the number of nodes. The target must have no buffer yet (new or after freeMemory()) or
+* the same capacity and element size, it may use another Alloc, e.g. MmapAlloc.
+* NOTE Nobody may modify the source meanwhile.
+* @param source ArrayArena or ArrayArenaMT
+* @param target Arena of the same Index type
+* @param threads number of threads copying the objects, large Arenas only
+*/
+template <typename SourceArena, typename TargetArena>
+void cloneInto(const SourceArena& source, TargetArena& target, unsigned threads = 1) {
+    ArenaMetadata meta = source.metadata();
+    target.restore(meta);
+    size_t size = size_t(meta.usedCapacity * meta.elementSize);
+    if (size != 0) {
+        detail::parallelCopy(target.begin(), source.begin(), size, threads);
+    }
+}
+
+/**
+* @brief Clone the Container with its Arena, the copy holds the same elements and is independent of the source.
+*
+* The Container bytes are copied as is, the requirements are the ones of saveSnapshot(): Universal config,
+* ConfigArenaPtr as ArenaPtr, the Container isn't on stack. The targetContainer memory must be raw,
+* point the target config to the target Arena and targetContainer to use the clone.
+* @param source ArrayArena or ArrayArenaMT
+* @param container the Container object
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+* @param target Arena of the same Index type, see cloneInto(source, target)
+* @param targetContainer memory for the Container object
+* @param threads number of threads copying the objects, large Arenas only
+*/
+template <typename SourceArena, typename TargetArena>
+void cloneInto(const SourceArena& source, const void* container, size_t containerSize,
+               TargetArena& target, void* targetContainer, unsigned threads = 1) {
+    cloneInto(source, target, threads);
+    std::memcpy(targetContainer, container, containerSize);
+}
+
+}
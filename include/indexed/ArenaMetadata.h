@@ -0,0 +1,64 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace indexed {
+
+/**
+* @brief State of ArrayArena / ArrayArenaMT besides its buffer, see metadata() and restore() of the Arenas.
+* Fixed-width fields, so it's written to snapshots as is.
+*/
+struct ArenaMetadata {
+    uint64_t capacity = 0;        // capacity in objects
+    uint64_t elementSize = 0;     // size of objects in bytes, 0 if the buffer isn't allocated
+    uint64_t usedCapacity = 0;    // objects taken from the buffer, only they are saved in snapshots
+    uint64_t allocatedCount = 0;  // alive objects
+    uint64_t freeListHead = 0;    // first index of the free list stored in the free objects
+    uint32_t indexSize = 0;       // sizeof(IndexType)
+    uint32_t deleteEnabled = 0;   // see enableDelete()
+};
+
+namespace detail {
+
+// throws std::invalid_argument if the metadata can't be restored into the Arena with the given Index
+template <typename Index>
+void checkArenaMetadata(const ArenaMetadata& meta) {
+    if (meta.indexSize != sizeof(Index)) {
+        throw std::invalid_argument("indexed::ArenaMetadata has another Index type");
+    }
+    if (meta.capacity >= (1u << (sizeof(Index) * 8 - 1))) {
+        throw std::invalid_argument("indexed::ArenaMetadata capacity is too big for Index type");
+    }
+    if (meta.elementSize % sizeof(Index) != 0 || meta.elementSize / sizeof(Index) > UINT16_MAX
+        || (meta.elementSize == 0 && meta.usedCapacity != 0)) {
+        throw std::invalid_argument("indexed::ArenaMetadata elementSize is invalid");
+    }
+    if (meta.usedCapacity > meta.capacity || meta.allocatedCount > meta.usedCapacity
+        || meta.freeListHead > meta.usedCapacity) {
+        throw std::invalid_argument("indexed::ArenaMetadata is inconsistent");
+    }
+}
+
+// the same for metadata read from a file or a stream, the Index type is given by indexSize
+inline void checkSavedArenaMetadata(const ArenaMetadata& meta) {
+    if (meta.indexSize == sizeof(uint16_t)) {
+        checkArenaMetadata<uint16_t>(meta);
+    } else if (meta.indexSize == sizeof(uint32_t)) {
+        checkArenaMetadata<uint32_t>(meta);
+    } else {
+        throw std::invalid_argument("indexed::ArenaMetadata has unsupported Index type");
+    }
+}
+
+}
+
+}
@@ -0,0 +1,175 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/CacheLine.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+namespace indexed {
+
+/**
+* @brief RCU-style publication of an Arena with its Container to reader threads.
+*
+* The writer builds a new Container in a new Arena, publish() switches the readers to it atomically and
+* returns the old pair once no reader uses it (the grace period), so the writer may destroy it.
+* Readers never wait and nothing is copied. A reader thread creates a Reader once (it takes one of
+* kMaxReaders slots) and wraps every read in a ReadLock, which sets the published Arena and Container
+* into ArenaConfig for this thread. So ArenaConfig must be a PerThread config, the writer thread uses
+* it for its own Arena meanwhile. The Container must not be modified after publish().
+* Grace periods are tracked with epochs: a locked reader announces the epoch it has entered,
+* publish() waits until every locked reader has entered after the switch. The reader slots are on separate
+* cache lines, aligned inside the object, so the publisher may be created anywhere, on heap as well,
+* it takes kMaxReaders + 1 cache lines for them.
+* @tparam ArenaConfig PerThread config of the Container
+* @tparam kMaxReaders maximum number of Reader objects at once
+*/
+template <typename ArenaConfig, size_t kMaxReaders = 64>
+class ArenaPublisher {
+public:
+    using Arena = typename ArenaConfig::Arena;
+
+    /**
+    * @brief Published Arena with its Container
+    */
+    struct Version {
+        Arena* arena;
+        void* container;
+    };
+
+    class ReadLock;
+
+    /**
+    * @brief Registration of a reader thread, keep it for the thread's lifetime
+    */
+    class Reader {
+    public:
+        explicit Reader(ArenaPublisher& publisher)
+        : m_publisher(publisher)
+        , m_slot(publisher.claimSlot()) {}
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        ~Reader() noexcept {
+            indexed_assert(m_publisher.m_slots[m_slot].epoch.load() == 0 && "indexed::ArenaPublisher::Reader is locked");
+            m_publisher.m_slots[m_slot].claimed.store(false, std::memory_order_release);
+        }
+
+    private:
+        friend class ReadLock;
+
+        ArenaPublisher& m_publisher;
+        size_t m_slot;
+    };
+
+    /**
+    * @brief Read-side critical section, the published Container stays valid until it's destructed.
+    * Don't nest the locks of one Reader.
+    */
+    class ReadLock {
+    public:
+        explicit ReadLock(Reader& reader) noexcept
+        : m_reader(reader) {
+            ArenaPublisher& publisher = reader.m_publisher;
+            std::atomic<uint64_t>& epoch = publisher.m_slots[reader.m_slot].epoch;
+            indexed_assert(epoch.load() == 0 && "indexed::ArenaPublisher::ReadLock is nested");
+            // the announcement must be visible before the current version is read
+            epoch.store(publisher.m_epoch.load());
+            m_version = publisher.m_current.load();
+            ArenaConfig::setArena(m_version->arena);
+            ArenaConfig::setContainer(m_version->container);
+        }
+
+        ReadLock(const ReadLock&) = delete;
+        ReadLock& operator=(const ReadLock&) = delete;
+
+        ~ReadLock() noexcept {
+            m_reader.m_publisher.m_slots[m_reader.m_slot].epoch.store(0, std::memory_order_release);
+        }
+
+        Arena* arena() const noexcept { return m_version->arena; }
+
+        void* container() const noexcept { return m_version->container; }
+
+    private:
+        Reader& m_reader;
+        const Version* m_version;
+    };
+
+    /**
+    * @brief Create the publisher with the first version
+    */
+    ArenaPublisher(Arena* arena, void* container) noexcept
+    : m_epoch(1)
+    , m_current(&m_versions[0])
+    , m_next(1) {
+        m_versions[0] = Version{arena, container};
+    }
+
+    ArenaPublisher(const ArenaPublisher&) = delete;
+    ArenaPublisher& operator=(const ArenaPublisher&) = delete;
+
+    /**
+    * @brief currently published version (the writer's view)
+    */
+    Version current() const noexcept { return *m_current.load(); }
+
+    /**
+    * @brief Switch the readers to the new Arena and Container, only one writer may call it at once.
+    * Blocks for the grace period: until the readers which might use the old version have unlocked.
+    * @return the old version, nobody uses it anymore
+    */
+    Version publish(Arena* arena, void* container) noexcept {
+        Version* next = &m_versions[m_next];
+        *next = Version{arena, container};
+        const Version* old = m_current.exchange(next);
+        m_next ^= 1;
+        uint64_t epoch = m_epoch.fetch_add(1) + 1;
+        for (size_t i = 0; i < kMaxReaders; ++i) {
+            for (; ;) {
+                uint64_t readerEpoch = m_slots[i].epoch.load();
+                if (readerEpoch == 0 || readerEpoch >= epoch) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        return *old;
+    }
+
+private:
+    size_t claimSlot() {
+        for (size_t i = 0; i < kMaxReaders; ++i) {
+            bool expected = false;
+            if (!m_slots[i].claimed.load(std::memory_order_relaxed)
+                && m_slots[i].claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return i;
+            }
+        }
+        throw std::length_error("indexed::ArenaPublisher has no free reader slots, increase kMaxReaders");
+    }
+
+    // slots of different readers are on separate cache lines, see m_slots
+    struct Slot {
+        std::atomic<uint64_t> epoch{0}; // 0 - not locked
+        std::atomic<bool> claimed{false};
+    };
+
+    std::atomic<uint64_t> m_epoch;
+    std::atomic<const Version*> m_current;
+    // the old version is kept until publish() returns, so two are enough for one writer
+    Version m_versions[2];
+    size_t m_next;
+    detail::CacheLineArray<Slot, kMaxReaders> m_slots;
+};
+
+}
@@ -0,0 +1,127 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArenaCheckpoint.h>
+#include <indexed/SpscRing.h>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace indexed {
+
+/**
+* @brief Send the Arena chunks modified since the last delta and the Container object to a follower.
+*
+* The leader Arena is a DirtyArena, call arena.markAllDirty() before the first delta, so the follower
+* gets the whole Arena. Its tracking must see every write (Compare or SoftDirty, see DirtyArena), otherwise
+* the follower gets corrupted nodes. The deltas have the format of saveDelta() and are prefixed with their
+* uint64_t size. The call blocks while the ring is full, so the follower lags at most by the ring capacity
+* plus one delta. The requirements for the Container are the ones of saveSnapshot().
+* NOTE Nobody may modify the Arena or the Container meanwhile.
+* @param arena DirtyArena of the leader
+* @param container the Container object
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+* @param ring producer side of the ring
+* @return number of sent chunks
+*/
+template <typename Arena>
+size_t replicateDelta(Arena& arena, const void* container, size_t containerSize, SpscRing& ring) {
+    std::vector<char> delta;
+    size_t chunks = detail::writeDelta(arena, container, containerSize, [&delta](const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        delta.insert(delta.end(), bytes, bytes + size);
+    });
+    uint64_t size = delta.size();
+    ring.write(&size, sizeof(size));
+    ring.write(delta.data(), delta.size());
+    return chunks;
+}
+
+/**
+* @brief Apply the next delta from the leader, if there is one, to the follower Arena and Container.
+*
+* The follower's Arena and Container become byte-identical to the leader's ones at the time of the delta,
+* the follower reads its Container between the calls (its config points to its own Arena and container memory).
+* The whole delta is taken from the ring and verified before anything is written: if it's corrupted
+* std::runtime_error is thrown, the follower stays at the previous delta and the ring is at the next one.
+* The later deltas lack the chunks of the lost one, so the replica must be synchronized again then,
+* e.g. the leader calls markAllDirty() before its next delta.
+* @param arena ArrayArena or ArrayArenaMT of the follower, empty before the first delta
+* @param container memory for the Container object (raw before the first delta)
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+* @param ring consumer side of the ring
+* @return false if there is no delta in the ring
+*/
+template <typename Arena>
+bool applyReplicatedDelta(Arena& arena, void* container, size_t containerSize, SpscRing& ring) {
+    if (ring.readable() == 0) {
+        return false;
+    }
+    uint64_t size;
+    ring.read(&size, sizeof(size));
+    std::vector<char> delta(static_cast<size_t>(size));
+    ring.read(delta.data(), delta.size());
+
+    const char* in = delta.data();
+    const char* end = delta.data() + delta.size();
+    auto take = [&in, end](size_t bytes) {
+        if (size_t(end - in) < bytes) {
+            throw std::runtime_error("indexed::applyReplicatedDelta delta is truncated");
+        }
+        const char* data = in;
+        in += bytes;
+        return data;
+    };
+    ArenaDeltaHeader header;
+    std::memcpy(&header, take(sizeof(header)), sizeof(header));
+    detail::checkDeltaHeader(header);
+    if (header.containerSize != containerSize) {
+        throw std::runtime_error("indexed::applyReplicatedDelta delta has another Container size");
+    }
+    const ArenaMetadata& meta = header.arena;
+    detail::checkArenaMetadata<typename Arena::IndexType>(meta);
+    const char* containerBytes = take(containerSize);
+    uint64_t dataSize = meta.usedCapacity * meta.elementSize;
+    for (uint64_t i = 0; i < header.chunkCount; ++i) {
+        uint64_t record[2];
+        std::memcpy(record, take(sizeof(record)), sizeof(record));
+        if (record[0] > dataSize || record[1] > dataSize - record[0]) {
+            throw std::runtime_error("indexed::applyReplicatedDelta delta is corrupted");
+        }
+        take(size_t(record[1]));
+    }
+    size_t checkedSize = size_t(in - delta.data());
+    uint64_t sum;
+    std::memcpy(&sum, take(sizeof(sum)), sizeof(sum));
+    detail::SnapshotChecksum checksum;
+    checksum.update(delta.data(), checkedSize);
+    if (in != end || sum != checksum.value()) {
+        throw std::runtime_error("indexed::applyReplicatedDelta checksum mismatch");
+    }
+
+    if (arena.begin() != nullptr && (arena.capacity() != meta.capacity || arena.elementSize() != meta.elementSize)) {
+        // the leader has released or reallocated its buffer
+        arena.freeMemory();
+    }
+    arena.restore(meta);
+    std::memcpy(container, containerBytes, containerSize);
+    in = containerBytes + containerSize;
+    for (uint64_t i = 0; i < header.chunkCount; ++i) {
+        uint64_t record[2];
+        std::memcpy(record, in, sizeof(record));
+        in += sizeof(record);
+        std::memcpy(arena.begin() + record[0], in, size_t(record[1]));
+        in += record[1];
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,107 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArenaMetadata.h>
+#include <indexed/Parallel.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace indexed {
+
+namespace detail {
+
+// bit i is set if the slot i is in the free list
+template <typename Arena>
+std::vector<uint64_t> freeSlotBitmap(const Arena& arena, const ArenaMetadata& meta) {
+    using Index = typename Arena::IndexType;
+    // ArrayArenaMT doesn't count objects, with deletion off its allocatedCount is just usedCapacity
+    if (Arena::kIsArrayArenaMT && meta.deleteEnabled == 0) {
+        throw std::logic_error("indexed::forEachLive can't tell deallocated objects, deletion is off");
+    }
+    size_t used = size_t(meta.usedCapacity);
+    std::vector<uint64_t> bitmap(used / 64 + 1, 0);
+    size_t freeCount = 0;
+    for (size_t index = size_t(meta.freeListHead); index != 0; ++freeCount) {
+        if (index > used || freeCount == used || (bitmap[index / 64] & (uint64_t(1) << (index % 64))) != 0) {
+            throw std::runtime_error("indexed::forEachLive free list is corrupted");
+        }
+        bitmap[index / 64] |= uint64_t(1) << (index % 64);
+        const char* slot = arena.begin() + (index - 1) * size_t(meta.elementSize);
+        index = *reinterpret_cast<const Index*>(slot);
+    }
+    if (freeCount + meta.allocatedCount != used) {
+        throw std::logic_error("indexed::forEachLive can't tell deallocated objects, deletion is off");
+    }
+    return bitmap;
+}
+
+}
+
+/**
+* @brief Call f for every allocated object of the Arena in index order, not in any Container order.
+*
+* The buffer is read sequentially, the free slots are skipped via a bitmap built from the free list,
+* so a full scan runs at memory bandwidth instead of a cache miss per Node. Useful for aggregations,
+* exports, rehashing. With threads > 1 the index range is split among the threads, f is called
+* concurrently then and it must be thread-safe. The objects may be modified in place,
+* but nothing may be allocated or deallocated meanwhile.
+* Throws std::logic_error if the Arena has deletion off and objects were deallocated (they can't be told apart),
+* for ArrayArenaMT with deletion off always, it can't tell whether objects were deallocated.
+* @param arena ArrayArena or ArrayArenaMT
+* @param f callable(IndexType index, void* object)
+* @param threads number of threads
+*/
+template <typename Arena, typename Func>
+void forEachLive(const Arena& arena, Func&& f, unsigned threads = 1) {
+    using Index = typename Arena::IndexType;
+    ArenaMetadata meta = arena.metadata();
+    if (meta.allocatedCount == 0) {
+        return;
+    }
+    std::vector<uint64_t> freeSlots = detail::freeSlotBitmap(arena, meta);
+    char* data = arena.begin();
+    size_t elementSize = size_t(meta.elementSize);
+    // parts are whole bitmap words, so threads don't share them
+    detail::parallelFor(size_t(meta.usedCapacity) + 1, threads, 4096, 64, [&](size_t begin, size_t end) {
+        for (size_t index = std::max<size_t>(begin, 1); index < end; ++index) {
+            if ((freeSlots[index / 64] & (uint64_t(1) << (index % 64))) == 0) {
+                f(Index(index), static_cast<void*>(data + (index - 1) * elementSize));
+            }
+        }
+    });
+}
+
+/**
+* @brief Call f for every element of the Container by a linear scan of its Arena, see forEachLive().
+* The Arena must hold only the Nodes of this Container, e.g. a map or a list. The element position
+* in the Node is taken from the first element.
+* @param container the Container
+* @param arena its Arena
+* @param f callable(value_type& element)
+* @param threads number of threads
+*/
+template <typename Container, typename Arena, typename Func>
+void forEachElement(Container& container, const Arena& arena, Func&& f, unsigned threads = 1) {
+    using Element = typename std::remove_reference<decltype(*container.begin())>::type;
+    if (container.begin() == container.end()) {
+        return;
+    }
+    const char* first = reinterpret_cast<const char*>(std::addressof(*container.begin()));
+    size_t offset = size_t(first - arena.begin()) % arena.elementSize();
+    forEachLive(arena, [offset, &f](typename Arena::IndexType, void* node) {
+        f(*reinterpret_cast<Element*>(static_cast<char*>(node) + offset));
+    }, threads);
+}
+
+}
@@ -0,0 +1,344 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArenaMetadata.h>
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+namespace indexed {
+
+/**
+* @brief Header of a snapshot made by saveSnapshot(), followed by the Container bytes and the Arena objects.
+*
+* The snapshot holds usedCapacity objects of the Arena, not the whole capacity. The objects start at
+* dataOffset, the end of the Container rounded up to kDataAlignment with zero bytes, so a mapped snapshot
+* keeps the Nodes aligned whatever the Container size is. The checksum covers the header (with zero
+* checksum field), the Container and the objects, not the padding. Fields are in the native byte order,
+* the snapshot is loaded on the same architecture by a build with the same Container layout.
+*/
+struct ArenaSnapshotHeader {
+    static constexpr uint32_t kVersion = 2;
+    static constexpr uint64_t kDataAlignment = 64;
+
+    char magic[8];            // "IDXSNAP"
+    uint32_t version;
+    uint32_t headerSize;      // sizeof(ArenaSnapshotHeader)
+    ArenaMetadata arena;
+    uint64_t containerSize;   // bytes of the Container object after the header
+    uint64_t dataOffset;      // offset of the Arena objects from the snapshot start, see snapshotDataOffset()
+    uint64_t dataSize;        // bytes of the Arena objects at dataOffset
+    uint64_t checksum;
+};
+
+namespace detail {
+
+// 64-bit FNV-1a over 8-byte words, the tail is zero-padded
+class SnapshotChecksum {
+public:
+    void update(const void* data, size_t size) noexcept {
+        const char* ptr = static_cast<const char*>(data);
+        while (size != 0 && m_pendingSize != 0) {
+            addPending(*ptr++);
+            --size;
+        }
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), ptr += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, ptr, sizeof(word));
+            addWord(word);
+        }
+        while (size != 0) {
+            addPending(*ptr++);
+            --size;
+        }
+    }
+
+    uint64_t value() const noexcept {
+        if (m_pendingSize == 0) {
+            return m_hash;
+        }
+        uint64_t word = 0;
+        std::memcpy(&word, m_pending, m_pendingSize);
+        return (m_hash ^ word) * kPrime;
+    }
+
+private:
+    static constexpr uint64_t kPrime = 1099511628211ull;
+
+    void addWord(uint64_t word) noexcept { m_hash = (m_hash ^ word) * kPrime; }
+
+    void addPending(char byte) noexcept {
+        m_pending[m_pendingSize++] = byte;
+        if (m_pendingSize == sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, m_pending, sizeof(word));
+            addWord(word);
+            m_pendingSize = 0;
+        }
+    }
+
+    uint64_t m_hash = 14695981039346656037ull;
+    char m_pending[sizeof(uint64_t)];
+    size_t m_pendingSize = 0;
+};
+
+// the Arena objects follow the header and the Container, aligned to kDataAlignment
+inline uint64_t snapshotDataOffset(uint64_t containerSize) noexcept {
+    const uint64_t alignment = ArenaSnapshotHeader::kDataAlignment;
+    return (sizeof(ArenaSnapshotHeader) + containerSize + alignment - 1) / alignment * alignment;
+}
+
+// bytes of zero padding between the Container and the Arena objects
+inline size_t snapshotPaddingSize(const ArenaSnapshotHeader& header) noexcept {
+    return size_t(header.dataOffset - sizeof(ArenaSnapshotHeader) - header.containerSize);
+}
+
+inline ArenaSnapshotHeader makeSnapshotHeader(const ArenaMetadata& meta, size_t containerSize) noexcept {
+    ArenaSnapshotHeader header = ArenaSnapshotHeader();
+    std::memcpy(header.magic, "IDXSNAP", sizeof(header.magic));
+    header.version = ArenaSnapshotHeader::kVersion;
+    header.headerSize = sizeof(ArenaSnapshotHeader);
+    header.arena = meta;
+    header.containerSize = containerSize;
+    header.dataOffset = snapshotDataOffset(containerSize);
+    header.dataSize = header.arena.usedCapacity * header.arena.elementSize;
+    return header;
+}
+
+template <typename Arena>
+ArenaSnapshotHeader makeSnapshotHeader(const Arena& arena, size_t containerSize) noexcept {
+    return makeSnapshotHeader(arena.metadata(), containerSize);
+}
+
+inline void checkSnapshotHeader(const ArenaSnapshotHeader& header, size_t containerSize) {
+    if (std::memcmp(header.magic, "IDXSNAP", sizeof(header.magic)) != 0
+        || header.headerSize != sizeof(ArenaSnapshotHeader)) {
+        throw std::runtime_error("indexed::loadSnapshot data isn't a snapshot");
+    }
+    if (header.version != ArenaSnapshotHeader::kVersion) {
+        throw std::runtime_error("indexed::loadSnapshot snapshot version isn't supported");
+    }
+    if (header.containerSize != containerSize) {
+        throw std::runtime_error("indexed::loadSnapshot snapshot has another Container size");
+    }
+    // the second check catches a wrapped sum for a corrupted containerSize
+    if (header.dataOffset != snapshotDataOffset(header.containerSize) || header.dataOffset < header.containerSize) {
+        throw std::runtime_error("indexed::loadSnapshot snapshot is corrupted");
+    }
+    // bounds capacity and elementSize, so dataSize can't overflow
+    try {
+        checkSavedArenaMetadata(header.arena);
+    } catch (const std::invalid_argument&) {
+        throw std::runtime_error("indexed::loadSnapshot snapshot is corrupted");
+    }
+    if (header.dataSize != header.arena.usedCapacity * header.arena.elementSize) {
+        throw std::runtime_error("indexed::loadSnapshot snapshot is corrupted");
+    }
+}
+
+inline uint64_t headerChecksum(ArenaSnapshotHeader header, SnapshotChecksum& checksum) noexcept {
+    uint64_t stored = header.checksum;
+    header.checksum = 0;
+    checksum.update(&header, sizeof(header));
+    return stored;
+}
+
+#ifndef WIN32
+
+inline void writeFull(int fd, const void* data, size_t size) {
+    const char* ptr = static_cast<const char*>(data);
+    while (size != 0) {
+        ssize_t res = ::write(fd, ptr, size);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "indexed::saveSnapshot write failed");
+        }
+        ptr += res;
+        size -= size_t(res);
+    }
+}
+
+inline void readFull(int fd, void* data, size_t size) {
+    char* ptr = static_cast<char*>(data);
+    while (size != 0) {
+        ssize_t res = ::read(fd, ptr, size);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "indexed::loadSnapshot read failed");
+        }
+        if (res == 0) {
+            throw std::runtime_error("indexed::loadSnapshot snapshot is truncated");
+        }
+        ptr += res;
+        size -= size_t(res);
+    }
+}
+
+#endif
+
+}
+
+/**
+* @brief Size of the snapshot of the Arena and the Container in bytes
+* @param arena ArrayArena or ArrayArenaMT
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+*/
+template <typename Arena>
+size_t snapshotSize(const Arena& arena, size_t containerSize) noexcept {
+    return size_t(detail::snapshotDataOffset(containerSize)) + arena.usedCapacity() * arena.elementSize();
+}
+
+/**
+* @brief Save the Arena and the Container object into the buffer.
+*
+* The Container bytes are copied as is, so it must keep no addresses: Universal config and
+* ConfigArenaPtr as ArenaPtr, the nodes are found via the Arena and the config. The Container must not
+* be on stack (Universal config would encode pointers to it as stack offsets), neither when saved nor loaded.
+* NOTE Nobody may modify the Arena or the Container meanwhile.
+* @param arena ArrayArena or ArrayArenaMT
+* @param container the Container object
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+* @param buf output buffer, see snapshotSize()
+* @param bufSize size of the buffer in bytes
+* @return size of the snapshot in bytes
+*/
+template <typename Arena>
+size_t saveSnapshot(const Arena& arena, const void* container, size_t containerSize, void* buf, size_t bufSize) {
+    size_t size = snapshotSize(arena, containerSize);
+    if (bufSize < size) {
+        throw std::length_error("indexed::saveSnapshot buffer is too small");
+    }
+    ArenaSnapshotHeader header = detail::makeSnapshotHeader(arena, containerSize);
+    detail::SnapshotChecksum checksum;
+    detail::headerChecksum(header, checksum);
+    checksum.update(container, containerSize);
+    checksum.update(arena.begin(), size_t(header.dataSize));
+    header.checksum = checksum.value();
+
+    char* out = static_cast<char*>(buf);
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), container, containerSize);
+    std::memset(out + sizeof(header) + containerSize, 0, detail::snapshotPaddingSize(header));
+    if (header.dataSize != 0) {
+        std::memcpy(out + header.dataOffset, arena.begin(), size_t(header.dataSize));
+    }
+    return size;
+}
+
+/**
+* @brief Load the Arena and the Container object saved with saveSnapshot().
+*
+* The Arena must have no buffer yet (new or after freeMemory()), it adopts the capacity, element size and
+* free list of the snapshot. The Container bytes are copied to the container address, the memory must be
+* raw (no constructed object there), call ArenaConfig::setContainer() with it afterwards.
+* Throws std::runtime_error if the snapshot is corrupted or doesn't match, nothing is changed then,
+* std::invalid_argument if the Arena can't adopt the metadata (see Arena::restore()).
+* @param arena ArrayArena or ArrayArenaMT
+* @param container memory for the Container object
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+* @param buf snapshot
+* @param bufSize size of the snapshot in bytes
+*/
+template <typename Arena>
+void loadSnapshot(Arena& arena, void* container, size_t containerSize, const void* buf, size_t bufSize) {
+    ArenaSnapshotHeader header;
+    if (bufSize < sizeof(header)) {
+        throw std::runtime_error("indexed::loadSnapshot snapshot is truncated");
+    }
+    std::memcpy(&header, buf, sizeof(header));
+    detail::checkSnapshotHeader(header, containerSize);
+    if (bufSize < header.dataOffset || bufSize - header.dataOffset < header.dataSize) {
+        throw std::runtime_error("indexed::loadSnapshot snapshot is truncated");
+    }
+    const char* in = static_cast<const char*>(buf);
+    detail::SnapshotChecksum checksum;
+    uint64_t stored = detail::headerChecksum(header, checksum);
+    checksum.update(in + sizeof(header), containerSize);
+    checksum.update(in + header.dataOffset, size_t(header.dataSize));
+    if (checksum.value() != stored) {
+        throw std::runtime_error("indexed::loadSnapshot checksum mismatch");
+    }
+    arena.restore(header.arena);
+    if (header.dataSize != 0) {
+        std::memcpy(arena.begin(), in + header.dataOffset, size_t(header.dataSize));
+    }
+    std::memcpy(container, in + sizeof(header), containerSize);
+}
+
+#ifndef WIN32
+
+/**
+* @brief Save the Arena and the Container object to the file descriptor, see saveSnapshot() for buffer
+*/
+template <typename Arena>
+void saveSnapshot(const Arena& arena, const void* container, size_t containerSize, int fd) {
+    ArenaSnapshotHeader header = detail::makeSnapshotHeader(arena, containerSize);
+    detail::SnapshotChecksum checksum;
+    detail::headerChecksum(header, checksum);
+    checksum.update(container, containerSize);
+    checksum.update(arena.begin(), size_t(header.dataSize));
+    header.checksum = checksum.value();
+    detail::writeFull(fd, &header, sizeof(header));
+    detail::writeFull(fd, container, containerSize);
+    const char padding[ArenaSnapshotHeader::kDataAlignment] = {};
+    detail::writeFull(fd, padding, detail::snapshotPaddingSize(header));
+    detail::writeFull(fd, arena.begin(), size_t(header.dataSize));
+}
+
+/**
+* @brief Load the Arena and the Container object from the file descriptor, see loadSnapshot() for buffer.
+* The objects are read directly to the Arena buffer, on error the Arena is left after freeMemory().
+*/
+template <typename Arena>
+void loadSnapshot(Arena& arena, void* container, size_t containerSize, int fd) {
+    ArenaSnapshotHeader header;
+    detail::readFull(fd, &header, sizeof(header));
+    detail::checkSnapshotHeader(header, containerSize);
+    detail::SnapshotChecksum checksum;
+    uint64_t stored = detail::headerChecksum(header, checksum);
+    std::vector<char> containerBytes(containerSize);
+    detail::readFull(fd, containerBytes.data(), containerSize);
+    checksum.update(containerBytes.data(), containerSize);
+    char padding[ArenaSnapshotHeader::kDataAlignment];
+    detail::readFull(fd, padding, detail::snapshotPaddingSize(header));
+    arena.restore(header.arena);
+    try {
+        detail::readFull(fd, arena.begin(), size_t(header.dataSize));
+        checksum.update(arena.begin(), size_t(header.dataSize));
+        if (checksum.value() != stored) {
+            throw std::runtime_error("indexed::loadSnapshot checksum mismatch");
+        }
+    } catch (...) {
+        // drop the objects, so the debug checks in freeMemory() don't walk a corrupted free list
+        ArenaMetadata empty = header.arena;
+        empty.usedCapacity = 0;
+        empty.allocatedCount = 0;
+        empty.freeListHead = 0;
+        arena.restore(empty);
+        arena.freeMemory();
+        throw;
+    }
+    std::memcpy(container, containerBytes.data(), containerSize);
+}
+
+#endif
+
+}
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <indexed/Config.h>
+#include <indexed/ArenaMetadata.h>
 
 #include <new>
 #include <cstdint>
@@ -124,6 +125,47 @@ public:
         m_capacity = Index(capacity);
     }
 
+    /**
+    * @brief State of the Arena besides its buffer, e.g. for ArenaSnapshot
+    */
+    ArenaMetadata metadata() const noexcept {
+        ArenaMetadata meta;
+        meta.capacity = m_capacity;
+        meta.elementSize = elementSize();
+        meta.usedCapacity = m_usedCapacity;
+        meta.allocatedCount = m_allocatedCount;
+        meta.freeListHead = m_nextFree;
+        meta.indexSize = sizeof(Index);
+        meta.deleteEnabled = m_doDelete;
+        return meta;
+    }
+
+    /**
+    * @brief Adopt the state obtained via metadata() of another Arena.
+    * Without a buffer the Arena allocates it via Alloc, the caller copies usedCapacity objects to begin() then.
+    * With a buffer the capacity and the element size must match, the buffer is kept (e.g. a replica).
+    * @param meta state of the Arena, see metadata()
+    */
+    void restore(const ArenaMetadata& meta) {
+        detail::checkArenaMetadata<Index>(meta);
+        if (begin() != nullptr) {
+            if (meta.capacity != m_capacity || meta.elementSize != elementSize()) {
+                throw std::runtime_error("indexed::ArenaMetadata doesn't match the Arena buffer");
+            }
+        } else {
+            setCapacity(size_t(meta.capacity));
+            if (meta.elementSize != 0) {
+                Alloc::malloc(size_t(meta.elementSize) * m_capacity);
+                indexed_trace(buffer_alloc, this, m_capacity, meta.elementSize * m_capacity);
+            }
+        }
+        m_elementSizeInIndex = decltype(m_elementSizeInIndex)(meta.elementSize / sizeof(Index));
+        m_doDelete = (meta.deleteEnabled != 0);
+        m_nextFree = Index(meta.freeListHead);
+        m_allocatedCount = Index(meta.allocatedCount);
+        m_usedCapacity = Index(meta.usedCapacity);
+    }
+
     /**
     * @brief Converts pointer to index
     * @param ptr pointer to element allocated with the Arena
@@ -143,38 +185,33 @@ public:
     * @return index assigned to the allocated object
     */
     Index allocate(size_t typeSize) {
-        indexed_assert((elementSize() == typeSize || elementSize() == 0)
-            && "indexed::ArrayArena can't handle different-sized allocations");
-        Index index = 0;
-        if (m_nextFree != 0) {
-            index = m_nextFree;
-            void* outPtr = getElementInt(index, typeSize);
-            m_nextFree = *static_cast<Index*>(outPtr);
-        } else {
-            if (m_usedCapacity == m_capacity) {
-                throw std::bad_alloc();
-            }
-            if (begin() == nullptr) {
-                indexed_assert(typeSize % sizeof(Index) == 0
-                    && "indexed::ArrayArena elementSize must be multiple of Index size");
-                Alloc::malloc(typeSize * m_capacity);
-                m_elementSizeInIndex = decltype(m_elementSizeInIndex)(typeSize / sizeof(Index));
-                indexed_assert(m_elementSizeInIndex == typeSize / sizeof(Index)
-                    && "indexed::ArrayArenaMT elementSize is too large");
-            }
-            ++m_usedCapacity;
-            index = m_usedCapacity;
+        Index index = allocateInt(typeSize);
+        if (index == 0) {
+            throw std::bad_alloc();
         }
-        ++m_allocatedCount;
         return index;
     }
 
+    /**
+    * @brief Allocate object in the Arena, don't throw when the Arena is full or memory allocation fails
+    * @param typeSize size of the object in bytes
+    * @return index assigned to the allocated object or 0 on failure
+    */
+    Index tryAllocate(size_t typeSize) noexcept {
+        try {
+            return allocateInt(typeSize);
+        } catch (const std::exception&) {
+            return 0;
+        }
+    }
+
     /**
     * @brief Deallocate object allocated before with the Arena
     * @param index index of the object obtained in allocate()
     * @param typeSize size of the object in bytes
     */
     void deallocate(Index index, size_t typeSize) noexcept {
+        indexed_trace(deallocate, this, index, typeSize);
         --m_allocatedCount;
         if (m_allocatedCount == 0) {
             reset();
@@ -193,6 +230,15 @@ public:
     */
     void reset() noexcept {
         indexed_warning(m_allocatedCount == 0 && "ArrayArena::reset() is called while there are allocated objects");
+        discard();
+    }
+
+    /**
+    * @brief Drop all allocated objects at once in O(1), they're forgotten, not deallocated (see abandon()).
+    * The memory isn't released, it's reused.
+    */
+    void discard() noexcept {
+        indexed_trace(reset, this, m_usedCapacity, m_allocatedCount);
         m_nextFree = 0;
         m_allocatedCount = 0;
         m_usedCapacity = 0;
@@ -203,6 +249,7 @@ public:
     * NOTE You should be sure that there are no allocated objects or they will never be used.
     */
     void freeMemory() noexcept {
+        indexed_trace(free_memory, this, m_capacity, elementSize());
         m_elementSizeInIndex = 0;
         reset();
         Alloc::free();
@@ -213,6 +260,37 @@ public:
     }
 
 private:
+    // returns 0 when the Arena is full
+    Index allocateInt(size_t typeSize) {
+        indexed_assert((elementSize() == typeSize || elementSize() == 0)
+            && "indexed::ArrayArena can't handle different-sized allocations");
+        Index index = 0;
+        if (m_nextFree != 0) {
+            index = m_nextFree;
+            void* outPtr = getElementInt(index, typeSize);
+            m_nextFree = *static_cast<Index*>(outPtr);
+        } else {
+            if (m_usedCapacity == m_capacity) {
+                indexed_trace(exhausted, this, m_capacity, typeSize);
+                return 0;
+            }
+            if (begin() == nullptr) {
+                indexed_assert(typeSize % sizeof(Index) == 0
+                    && "indexed::ArrayArena elementSize must be multiple of Index size");
+                Alloc::malloc(typeSize * m_capacity);
+                indexed_trace(buffer_alloc, this, m_capacity, typeSize * m_capacity);
+                m_elementSizeInIndex = decltype(m_elementSizeInIndex)(typeSize / sizeof(Index));
+                indexed_assert(m_elementSizeInIndex == typeSize / sizeof(Index)
+                    && "indexed::ArrayArenaMT elementSize is too large");
+            }
+            ++m_usedCapacity;
+            index = m_usedCapacity;
+        }
+        ++m_allocatedCount;
+        indexed_trace(allocate, this, index, typeSize);
+        return index;
+    }
+
     void* getElementInt(Index index, size_t elementSize) const noexcept {
         indexed_assert(index > 0 && index <= m_usedCapacity && "indexed::Pointer is invalid");
         return begin() + elementSize * (index - 1);
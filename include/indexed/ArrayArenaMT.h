@@ -7,6 +7,7 @@
 #pragma once
 
 #include <indexed/Config.h>
+#include <indexed/ArenaMetadata.h>
 
 #include <new>
 #include <cstdint>
@@ -41,12 +42,26 @@ private:
     static constexpr uint8_t kBits = sizeof(IndexType) * 8;
 
 public:
+#if INDEXED_CAS_STATS == 1
+    LockFreeSList() noexcept
+    : m_head(0)
+    , m_casRetries(0) {}
+
+    size_t casRetryCount() const noexcept { return m_casRetries.load(std::memory_order_relaxed); }
+#else
     LockFreeSList() noexcept
     : m_head(0) {}
 
+    size_t casRetryCount() const noexcept { return 0; }
+#endif
+
     void reset() noexcept { m_head = 0; }
 
-    IndexType listLength(Arena& arena) const noexcept {
+    IndexType head() const noexcept { return IndexType(m_head.load()); }
+
+    void setHead(IndexType head) noexcept { m_head = head; }
+
+    IndexType listLength(const Arena& arena) const noexcept {
         IndexType len = 0;
         IndexType next = IndexType(m_head);
         while (next != 0) {
@@ -70,6 +85,7 @@ public:
             if (m_head.compare_exchange_strong(headD, futureHeadD)) {
                 return head;
             }
+            countCasRetry();
         }
     }
 
@@ -82,6 +98,7 @@ public:
             if (m_head.compare_exchange_strong(headD, futureHeadD)) {
                 break;
             }
+            countCasRetry();
         }
     }
 
@@ -90,7 +107,17 @@ private:
 
     static DoubleIndex toDoubleIndex(IndexType index, DoubleIndex stamp) noexcept { return (stamp << kBits) | index; }
 
+    void countCasRetry() noexcept {
+#if INDEXED_CAS_STATS == 1
+        m_casRetries.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
     std::atomic<DoubleIndex> m_head;
+#if INDEXED_CAS_STATS == 1
+    // shares the cache line with m_head, the counter isn't compiled in by default
+    std::atomic<size_t> m_casRetries;
+#endif
 };
 
 }
@@ -170,6 +197,11 @@ public:
     */
     size_t elementSize() const noexcept { return m_elementSizeInIndex * sizeof(Index); }
 
+    /**
+    * @brief number of failed CAS on the free list, always 0 unless INDEXED_CAS_STATS=1 (mostly for benchmarks)
+    */
+    size_t casRetryCount() const noexcept { return m_freeList.casRetryCount(); }
+
     /**
     * @brief true if deletion is on, see enableDelete()
     */
@@ -205,6 +237,48 @@ public:
         m_capacity = Index(capacity);
     }
 
+    /**
+    * @brief State of the Arena besides its buffer, e.g. for ArenaSnapshot.
+    * NOTE The method is not MT-safe, it walks the free list to count the alive objects.
+    */
+    ArenaMetadata metadata() const noexcept {
+        ArenaMetadata meta;
+        meta.capacity = m_capacity;
+        meta.elementSize = elementSize();
+        meta.usedCapacity = m_usedCapacity;
+        meta.allocatedCount = m_doDelete ? meta.usedCapacity - m_freeList.listLength(*this) : meta.usedCapacity;
+        meta.freeListHead = m_freeList.head();
+        meta.indexSize = sizeof(Index);
+        meta.deleteEnabled = m_doDelete;
+        return meta;
+    }
+
+    /**
+    * @brief Adopt the state obtained via metadata() of another Arena.
+    * Without a buffer the Arena allocates it via Alloc, the caller copies usedCapacity objects to begin() then.
+    * With a buffer the capacity and the element size must match, the buffer is kept (e.g. a replica).
+    * NOTE The method is not MT-safe, read freeMemory() for details.
+    * @param meta state of the Arena, see metadata()
+    */
+    void restore(const ArenaMetadata& meta) {
+        detail::checkArenaMetadata<Index>(meta);
+        if (begin() != nullptr) {
+            if (meta.capacity != m_capacity || meta.elementSize != elementSize()) {
+                throw std::runtime_error("indexed::ArenaMetadata doesn't match the Arena buffer");
+            }
+        } else {
+            setCapacity(size_t(meta.capacity));
+            if (meta.elementSize != 0) {
+                Alloc::malloc(size_t(meta.elementSize) * m_capacity);
+                indexed_trace(buffer_alloc, this, m_capacity, meta.elementSize * m_capacity);
+            }
+        }
+        m_elementSizeInIndex = decltype(m_elementSizeInIndex)(meta.elementSize / sizeof(Index));
+        m_doDelete = (meta.deleteEnabled != 0);
+        m_freeList.setHead(Index(meta.freeListHead));
+        m_usedCapacity = Index(meta.usedCapacity);
+    }
+
     /**
     * @brief Converts pointer to index
     * @param ptr pointer to element allocated with the Arena
@@ -224,33 +298,34 @@ public:
     * @return index assigned to the allocated object
     */
     Index allocate(size_t typeSize) {
-        indexed_assert((elementSize() == 0 || elementSize() == typeSize)
-            && "indexed::ArrayArenaMT can't handle different-sized allocations");
-        // NOTE should first check for m_doDelete?
-        Index index = m_freeList.pull(*this);
+        Index index = allocateInt(typeSize);
         if (index == 0) {
-            Index futureCapacity = ++m_usedCapacity;
-            try {
-                if (futureCapacity > m_capacity) {
-                    throw std::bad_alloc();
-                }
-                if (begin() == nullptr) {
-                    allocateBuffer(typeSize);
-                }
-            } catch (const std::exception&) {
-                --m_usedCapacity;
-                throw;
-            }
-            index = futureCapacity;
+            throw std::bad_alloc();
         }
         return index;
     }
 
+    /**
+    * @brief Allocate object in the Arena, don't throw when the Arena is full or memory allocation fails
+    * @param typeSize size of the object in bytes
+    * @return index assigned to the allocated object or 0 on failure
+    */
+    Index tryAllocate(size_t typeSize) noexcept {
+        try {
+            return allocateInt(typeSize);
+        } catch (const std::exception&) {
+            return 0;
+        }
+    }
+
     /**
     * @brief Deallocate object allocated before with the Arena
     * @param index index of the object obtained in allocate()
+    * @param typeSize size of the object in bytes
     */
-    void deallocate(Index index, size_t) noexcept {
+    void deallocate(Index index, size_t typeSize) noexcept {
+        indexed_trace(deallocate, this, index, typeSize);
+        (void)typeSize;
         if (m_doDelete) {
             m_freeList.push(index, *this);
         }
@@ -265,6 +340,16 @@ public:
     void reset() noexcept {
         indexed_warning(m_usedCapacity == m_freeList.listLength(*this)
             && "ArrayArenaMT::reset() is called while there are allocated objects");
+        discard();
+    }
+
+    /**
+    * @brief Drop all allocated objects at once in O(1), they're forgotten, not deallocated (see abandon()).
+    * The memory isn't released, it's reused.
+    * NOTE The method is not MT-safe, read freeMemory() for details.
+    */
+    void discard() noexcept {
+        indexed_trace(reset, this, m_usedCapacity.load(), 0);
         m_freeList.reset();
         m_usedCapacity = 0;
     }
@@ -276,6 +361,7 @@ public:
     *      the threads sharing the Arena (or once they've joined in one thread).
     */
     void freeMemory() noexcept {
+        indexed_trace(free_memory, this, m_capacity, elementSize());
         Alloc::free();
         m_elementSizeInIndex = 0;
         m_isAllocError = false;
@@ -288,6 +374,33 @@ public:
     }
 
 private:
+    // returns 0 when the Arena is full
+    Index allocateInt(size_t typeSize) {
+        indexed_assert((elementSize() == 0 || elementSize() == typeSize)
+            && "indexed::ArrayArenaMT can't handle different-sized allocations");
+        // NOTE should first check for m_doDelete?
+        Index index = m_freeList.pull(*this);
+        if (index == 0) {
+            Index futureCapacity = ++m_usedCapacity;
+            if (futureCapacity > m_capacity) {
+                --m_usedCapacity;
+                indexed_trace(exhausted, this, m_capacity, typeSize);
+                return 0;
+            }
+            if (begin() == nullptr) {
+                try {
+                    allocateBuffer(typeSize);
+                } catch (const std::exception&) {
+                    --m_usedCapacity;
+                    throw;
+                }
+            }
+            index = futureCapacity;
+        }
+        indexed_trace(allocate, this, index, typeSize);
+        return index;
+    }
+
     void* getElementInt(Index index, size_t elementSize) const noexcept {
         indexed_assert(index > 0 && index <= m_usedCapacity && "indexed::Pointer is invalid");
         return begin() + elementSize * (index - 1);
@@ -305,6 +418,7 @@ private:
             && "indexed::ArrayArenaMT elementSize must be multiple of Index size");
         try {
             Alloc::malloc(typeSize * m_capacity);
+            indexed_trace(buffer_alloc, this, m_capacity, typeSize * m_capacity);
         } catch (const std::exception&) {
             m_isAllocError = true;
             throw;
@@ -0,0 +1,65 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace indexed {
+
+namespace detail {
+
+constexpr size_t kCacheLineSize = 64;
+
+/**
+* @brief kSize objects, each on its own cache line, inside the owning object.
+*
+* The storage has one spare line and the first object is aligned manually. alignas wouldn't do: before C++17
+* new doesn't honour alignment above alignof(max_align_t), so it would be lost for heap-allocated owners.
+* The objects are constructed by the default constructor.
+*/
+template <typename Type, size_t kSize>
+class CacheLineArray {
+    static_assert(sizeof(Type) <= kCacheLineSize && alignof(Type) <= kCacheLineSize,
+                  "indexed::CacheLineArray object must fit a cache line");
+
+public:
+    CacheLineArray() noexcept {
+        for (size_t i = 0; i < kSize; ++i) {
+            ::new (static_cast<void*>(get(i))) Type();
+        }
+    }
+
+    ~CacheLineArray() {
+        for (size_t i = 0; i < kSize; ++i) {
+            get(i)->~Type();
+        }
+    }
+
+    CacheLineArray(const CacheLineArray&) = delete;
+    CacheLineArray& operator=(const CacheLineArray&) = delete;
+
+    static constexpr size_t size() noexcept { return kSize; }
+
+    Type& operator[](size_t i) noexcept { return *get(i); }
+
+    const Type& operator[](size_t i) const noexcept { return *get(i); }
+
+private:
+    Type* get(size_t i) const noexcept {
+        uintptr_t first = (reinterpret_cast<uintptr_t>(m_storage) + kCacheLineSize - 1) / kCacheLineSize
+                          * kCacheLineSize;
+        return reinterpret_cast<Type*>(first + i * kCacheLineSize);
+    }
+
+    char m_storage[(kSize + 1) * kCacheLineSize];
+};
+
+}
+
+}
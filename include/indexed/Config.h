@@ -14,6 +14,36 @@
 #endif
 #endif
 
+// count failed CAS in lock-free structures of ArrayArenaMT (mostly for benchmarks),
+// must be defined equally for all translation units
+#ifndef INDEXED_CAS_STATS
+#define INDEXED_CAS_STATS 0
+#endif
+
+// static tracepoints on Arena events (allocate, deallocate, exhausted, reset, free_memory, buffer_alloc):
+// 0 - off, no code is generated
+// 1 - USDT probes of provider "indexed" via <sys/sdt.h>, e.g. bpftrace -e 'usdt:./app:indexed:exhausted { ... }'
+// 2 - call INDEXED_TRACE_HOOK(event, arena, arg1, arg2) defined by user, event is a string literal
+// every probe gets the Arena address and two integers, see the call sites for their meaning,
+// must be defined equally for all translation units
+#ifndef INDEXED_TRACE
+#define INDEXED_TRACE 0
+#endif
+
+#if INDEXED_TRACE == 1
+#include <sys/sdt.h>
+#define indexed_trace(event, arena, arg1, arg2) DTRACE_PROBE3(indexed, event, \
+static_cast<const void*>(arena), static_cast<unsigned long>(arg1), static_cast<unsigned long>(arg2))
+#elif INDEXED_TRACE == 2
+#ifndef INDEXED_TRACE_HOOK
+#error "INDEXED_TRACE=2 requires INDEXED_TRACE_HOOK(event, arena, arg1, arg2) definition"
+#endif
+#define indexed_trace(event, arena, arg1, arg2) INDEXED_TRACE_HOOK(#event, \
+static_cast<const void*>(arena), static_cast<size_t>(arg1), static_cast<size_t>(arg2))
+#else
+#define indexed_trace(event, arena, arg1, arg2) ((void)0)
+#endif
+
 #if INDEXED_DEBUG == 1
 #include <cstdio>
 #define indexed_warning(arg) if (!(arg)) std::fprintf(stderr, "Warning `%s' triggered at %s:%d\n", \
@@ -30,3 +60,9 @@
 #define indexed_assert(arg) ((void)0)
 #define indexed_warning(arg) ((void)0)
 #endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define indexed_prefetch(ptr) __builtin_prefetch(ptr)
+#else
+#define indexed_prefetch(ptr) ((void)0)
+#endif
@@ -0,0 +1,38 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+namespace indexed {
+
+/**
+* @brief Empty Arena pointer for Allocator, it's resolved to ArenaConfig::getArena() on every use.
+*
+* Allocator keeps ArenaConfig::ArenaPtr, by default a raw pointer valid only in the process which has created
+* the Allocator. When a Container (and so its Allocator) is placed in memory shared between processes,
+* every process sets its own Arena into the config and the Allocator must not store any address.
+* Define in your config:
+*   using ArenaPtr = ConfigArenaPtr<MyConfig>;
+*   static ArenaPtr defaultArena() noexcept { return ArenaPtr(); }
+* @tparam ArenaConfig config class with getArena()
+*/
+template <typename ArenaConfig>
+class ConfigArenaPtr {
+public:
+    auto operator->() const noexcept -> decltype(ArenaConfig::getArena()) { return ArenaConfig::getArena(); }
+
+    auto operator*() const noexcept -> decltype(*ArenaConfig::getArena()) { return *ArenaConfig::getArena(); }
+
+    friend
+    bool operator==(const ConfigArenaPtr&, const ConfigArenaPtr&) noexcept { return true; }
+
+    friend
+    bool operator!=(const ConfigArenaPtr&, const ConfigArenaPtr&) noexcept { return false; }
+};
+
+}
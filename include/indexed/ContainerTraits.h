@@ -0,0 +1,31 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <type_traits>
+
+namespace indexed {
+
+namespace detail {
+
+template <typename Type>
+struct ToVoid {
+    using type = void;
+};
+
+/**
+* @brief true for hash containers (boost::unordered set/map), they have bucket local_iterator
+*/
+template <typename Container, typename = void>
+struct IsUnorderedContainer : std::false_type {};
+
+template <typename Container>
+struct IsUnorderedContainer<Container, typename ToVoid<typename Container::local_iterator>::type> : std::true_type {};
+
+}
+
+}
@@ -0,0 +1,366 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArenaSnapshot.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace indexed {
+
+/**
+* @brief How DirtyArena finds modified chunks, see DirtyArena::setTracking()
+*/
+enum class DirtyTracking {
+    Barrier,    // allocate(), deallocate() and touch() mark chunks, every write in place must be touch()ed
+    SoftDirty,  // Barrier plus the kernel soft-dirty page bits (Linux CONFIG_MEM_SOFT_DIRTY)
+    Compare     // Barrier plus comparing a hash of every chunk with the one of the last checkpoint (default)
+};
+
+namespace detail {
+
+#ifndef WIN32
+
+// clears the soft-dirty bits of the whole process
+inline bool clearSoftDirty() noexcept {
+    int fd = ::open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool res = (::write(fd, "4", 1) == 1);
+    ::close(fd);
+    return res;
+}
+
+// reads the soft-dirty bits of the pages, bit 55 of /proc/self/pagemap entries
+inline bool readSoftDirty(const void* begin, size_t pages, std::vector<bool>& dirty) {
+    static const size_t pageSize = size_t(::sysconf(_SC_PAGESIZE));
+    int fd = ::open("/proc/self/pagemap", O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    dirty.assign(pages, false);
+    std::vector<uint64_t> entries(1024);
+    off_t pos = off_t(reinterpret_cast<uintptr_t>(begin) / pageSize * sizeof(uint64_t));
+    bool res = true;
+    for (size_t page = 0; page < pages && res; ) {
+        size_t count = std::min(entries.size(), pages - page);
+        ssize_t bytes = ::pread(fd, entries.data(), count * sizeof(uint64_t), pos);
+        res = (bytes == ssize_t(count * sizeof(uint64_t)));
+        for (size_t i = 0; res && i < count; ++i) {
+            dirty[page + i] = ((entries[i] >> 55) & 1) != 0;
+        }
+        page += count;
+        pos += off_t(count * sizeof(uint64_t));
+    }
+    ::close(fd);
+    return res;
+}
+
+// writes a page after clearing the bits and checks that the kernel has marked it
+inline bool probeSoftDirty() noexcept {
+    static const size_t pageSize = size_t(::sysconf(_SC_PAGESIZE));
+    void* page = ::mmap(nullptr, pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        return false;
+    }
+    bool res = false;
+    try {
+        std::vector<bool> dirty;
+        *static_cast<volatile char*>(page) = 1;
+        if (clearSoftDirty()) {
+            *static_cast<volatile char*>(page) = 2;
+            res = readSoftDirty(page, 1, dirty) && dirty[0];
+        }
+    } catch (const std::exception&) {}
+    ::munmap(page, pageSize);
+    return res;
+}
+
+#endif
+
+}
+
+/**
+* @brief Arena tracking modified chunks of its buffer for incremental checkpoints, see saveDelta().
+*
+* The buffer is split in chunks of kChunkSlots objects, a bitmap keeps the chunks modified since the last
+* clearDirty(). allocate() and deallocate() mark the chunk of the object (deallocate() writes the free list
+* into the object), touch() marks an object modified in place. Containers also modify nodes the Arena doesn't
+* see: insert and erase rewrite the links of the neighbour and parent nodes, tree rebalancing, value updates.
+* So the tracking (see setTracking()) is Compare by default: it hashes every used chunk on collectDirty()
+* and reads the whole buffer, but never misses a write. SoftDirty uses the kernel page bits (one user per
+* process, the bits are cleared for the whole process). Barrier is valid only if every object written
+* in place is touch()ed, e.g. not for boost containers, otherwise the deltas are silently corrupted.
+* Marking is MT-safe (relaxed atomics), collectDirty() / clearDirty() are not, call them when the Arena
+* and the Container are consistent.
+* @tparam Arena ArrayArena or ArrayArenaMT
+* @tparam kChunkSlots objects per chunk
+*/
+template <typename Arena, size_t kChunkSlots = 64>
+class DirtyArena : public Arena {
+    static_assert(kChunkSlots > 0, "indexed::DirtyArena chunk can't be empty");
+
+public:
+    using IndexType = typename Arena::IndexType;
+
+    /**
+    * @brief Create Arena, see ArrayArena::ArrayArena()
+    */
+    template <typename ...Args>
+    explicit DirtyArena(Args&&... args)
+    : Arena(std::forward<Args>(args)...)
+    , m_tracking(DirtyTracking::Compare) {
+        resizeBitmap();
+    }
+
+    DirtyArena(const DirtyArena&) = delete;
+    DirtyArena& operator=(const DirtyArena&) = delete;
+
+    /**
+    * @brief Set Arena capacity, see ArrayArena::setCapacity()
+    */
+    void setCapacity(size_t capacity) {
+        Arena::setCapacity(capacity);
+        resizeBitmap();
+    }
+
+    /**
+    * @brief Adopt the state of another Arena, see ArrayArena::restore().
+    * Call clearDirty() once the objects are loaded.
+    */
+    void restore(const ArenaMetadata& meta) {
+        size_t capacity = Arena::capacity();
+        Arena::restore(meta);
+        if (capacity != Arena::capacity()) {
+            resizeBitmap();
+        }
+    }
+
+    /**
+    * @brief Choose the tracking, call it before the base snapshot (it's followed by clearDirty())
+    * @return false if the tracking isn't supported (SoftDirty), the tracking isn't changed then
+    */
+    bool setTracking(DirtyTracking tracking) {
+#ifndef WIN32
+        if (tracking == DirtyTracking::SoftDirty && !detail::probeSoftDirty()) {
+            return false;
+        }
+#else
+        if (tracking == DirtyTracking::SoftDirty) {
+            return false;
+        }
+#endif
+        m_tracking = tracking;
+        return true;
+    }
+
+    DirtyTracking tracking() const noexcept { return m_tracking; }
+
+    /**
+    * @brief Allocate object and mark its chunk, see Arena::allocate()
+    */
+    IndexType allocate(size_t typeSize) {
+        IndexType index = Arena::allocate(typeSize);
+        touch(index);
+        return index;
+    }
+
+    /**
+    * @brief Allocate object and mark its chunk, see Arena::tryAllocate()
+    */
+    IndexType tryAllocate(size_t typeSize) noexcept {
+        IndexType index = Arena::tryAllocate(typeSize);
+        if (index != 0) {
+            touch(index);
+        }
+        return index;
+    }
+
+    /**
+    * @brief Deallocate object and mark its chunk, see Arena::deallocate()
+    */
+    void deallocate(IndexType index, size_t typeSize) noexcept {
+        touch(index);
+        Arena::deallocate(index, typeSize);
+    }
+
+    /**
+    * @brief Mark all used chunks, e.g. to send the whole Arena as the first delta
+    */
+    void markAllDirty() noexcept {
+        for (size_t chunk = 0; chunk < usedChunks(); ++chunk) {
+            touch(IndexType(chunk * kChunkSlots + 1));
+        }
+    }
+
+    /**
+    * @brief Mark the chunk of the object modified in place
+    * @param index index of the object
+    */
+    void touch(IndexType index) noexcept {
+        size_t chunk = size_t(index - 1) / kChunkSlots;
+        uint64_t bit = uint64_t(1) << (chunk % 64);
+        std::atomic<uint64_t>& word = m_dirty[chunk / 64];
+        if ((word.load(std::memory_order_relaxed) & bit) == 0) {
+            word.fetch_or(bit, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+    * @brief Mark the chunk of the object modified in place
+    * @param ptr any address inside the object, e.g. &(*it).second
+    */
+    void touch(const void* ptr) noexcept {
+        touch(IndexType(size_t(static_cast<const char*>(ptr) - Arena::begin()) / Arena::elementSize() + 1));
+    }
+
+    /**
+    * @brief size of chunk in bytes
+    */
+    size_t chunkBytes() const noexcept { return kChunkSlots * Arena::elementSize(); }
+
+    /**
+    * @brief true if the chunk is modified
+    */
+    bool isDirty(size_t chunk) const noexcept {
+        return (m_dirty[chunk / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (chunk % 64))) != 0;
+    }
+
+    /**
+    * @brief Add the chunks found by SoftDirty / Compare tracking to the bitmap
+    * @return number of modified chunks within usedCapacity
+    */
+    size_t collectDirty() {
+        size_t chunks = usedChunks();
+        if (m_tracking == DirtyTracking::Compare) {
+            compareChunks(chunks, true);
+        }
+#ifndef WIN32
+        if (m_tracking == DirtyTracking::SoftDirty && chunks != 0) {
+            collectSoftDirty();
+        }
+#endif
+        size_t count = 0;
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            count += isDirty(chunk);
+        }
+        return count;
+    }
+
+    /**
+    * @brief Call func(offset, size) for every modified chunk within usedCapacity, offset from begin() in bytes.
+    * Call collectDirty() before.
+    */
+    template <typename Func>
+    void forEachDirtyChunk(Func&& func) const {
+        size_t chunks = usedChunks();
+        size_t usedBytes = Arena::usedCapacity() * Arena::elementSize();
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            if (isDirty(chunk)) {
+                size_t offset = chunk * chunkBytes();
+                func(offset, std::min(chunkBytes(), usedBytes - offset));
+            }
+        }
+    }
+
+    /**
+    * @brief Mark all chunks clean, e.g. after a snapshot or a delta is saved
+    */
+    void clearDirty() {
+        for (size_t i = 0; i < m_words; ++i) {
+            m_dirty[i].store(0, std::memory_order_relaxed);
+        }
+        if (m_tracking == DirtyTracking::Compare) {
+            compareChunks(usedChunks(), false);
+        }
+#ifndef WIN32
+        if (m_tracking == DirtyTracking::SoftDirty) {
+            detail::clearSoftDirty();
+        }
+#endif
+    }
+
+private:
+    size_t usedChunks() const noexcept { return (Arena::usedCapacity() + kChunkSlots - 1) / kChunkSlots; }
+
+    void resizeBitmap() {
+        size_t chunks = (Arena::capacity() + kChunkSlots - 1) / kChunkSlots;
+        m_words = (chunks + 63) / 64;
+        m_dirty.reset(new std::atomic<uint64_t>[m_words]);
+        for (size_t i = 0; i < m_words; ++i) {
+            m_dirty[i].store(0, std::memory_order_relaxed);
+        }
+        m_hashes.clear();
+    }
+
+    // updates the hashes, marks the chunks with changed hashes if requested
+    void compareChunks(size_t chunks, bool mark) {
+        if (m_hashes.size() < chunks) {
+            m_hashes.resize(chunks, 0);
+        }
+        size_t bytes = chunkBytes();
+        size_t usedBytes = Arena::usedCapacity() * Arena::elementSize();
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            size_t offset = chunk * bytes;
+            detail::SnapshotChecksum checksum;
+            checksum.update(Arena::begin() + offset, std::min(bytes, usedBytes - offset));
+            uint64_t hash = checksum.value();
+            if (mark && hash != m_hashes[chunk]) {
+                touch(IndexType(chunk * kChunkSlots + 1));
+            }
+            m_hashes[chunk] = hash;
+        }
+    }
+
+#ifndef WIN32
+    void collectSoftDirty() {
+        static const size_t pageSize = size_t(::sysconf(_SC_PAGESIZE));
+        const char* begin = Arena::begin();
+        size_t usedBytes = Arena::usedCapacity() * Arena::elementSize();
+        uintptr_t firstPage = reinterpret_cast<uintptr_t>(begin) / pageSize * pageSize;
+        size_t pages = (reinterpret_cast<uintptr_t>(begin) + usedBytes - firstPage + pageSize - 1) / pageSize;
+        std::vector<bool> dirty;
+        if (!detail::readSoftDirty(reinterpret_cast<const void*>(firstPage), pages, dirty)) {
+            // can't read the bits, don't lose the changes
+            markAllDirty();
+            return;
+        }
+        size_t bytes = chunkBytes();
+        for (size_t page = 0; page < pages; ++page) {
+            if (!dirty[page]) {
+                continue;
+            }
+            const char* pageBegin = reinterpret_cast<const char*>(firstPage + page * pageSize);
+            size_t from = (pageBegin > begin) ? size_t(pageBegin - begin) : 0;
+            size_t to = std::min(usedBytes, size_t(pageBegin + pageSize - begin));
+            for (size_t chunk = from / bytes; chunk * bytes < to; ++chunk) {
+                touch(IndexType(chunk * kChunkSlots + 1));
+            }
+        }
+    }
+#endif
+
+    std::unique_ptr<std::atomic<uint64_t>[]> m_dirty; // bit per chunk
+    size_t m_words = 0;
+    std::vector<uint64_t> m_hashes; // Compare tracking, per used chunk
+    DirtyTracking m_tracking;
+};
+
+}
@@ -0,0 +1,116 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+#ifdef WIN32
+#error "indexed::ForkSnapshot requires fork()"
+#endif
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace indexed {
+
+/**
+* @brief Point-in-time copy-on-write snapshot of the process memory, e.g. of Arenas with their Containers.
+*
+* The constructor forks, the child process calls the reader with a frozen copy of the memory and exits
+* with the reader's result, while the parent keeps modifying the Containers. The kernel copies only the pages
+* modified after the fork, so the cost is the page tables plus the touched pages, not the Container size.
+* The Pointers stay valid in the child, it has the same addresses. A typical reader is a checkpoint:
+* saveSnapshot() to a file descriptor, or a consistent scan which reports via a pipe or a file.
+* Create the snapshot when the Containers are consistent: in the writer thread between modifications,
+* or with all writers paused. Only the forking thread exists in the child, so the reader must not take locks
+* which other threads could hold, e.g. malloc() in a multi-threaded process.
+*/
+class ForkSnapshot {
+public:
+    /**
+    * @brief Fork and run the reader in the child process
+    * @param reader callable returning int, the child's exit code (0 means success), exception gives 1
+    */
+    template <typename Reader>
+    explicit ForkSnapshot(Reader&& reader)
+    : m_pid(::fork())
+    , m_status(0)
+    , m_waited(false) {
+        if (m_pid < 0) {
+            throw std::system_error(errno, std::generic_category(), "indexed::ForkSnapshot fork failed");
+        }
+        if (m_pid == 0) {
+            int code = 1;
+            try {
+                code = std::forward<Reader>(reader)();
+            } catch (...) {}
+            ::_exit(code);
+        }
+    }
+
+    ForkSnapshot(const ForkSnapshot&) = delete;
+    ForkSnapshot& operator=(const ForkSnapshot&) = delete;
+
+    /**
+    * @brief pid of the child process
+    */
+    pid_t pid() const noexcept { return m_pid; }
+
+    /**
+    * @brief true if the reader has finished, doesn't block
+    */
+    bool finished() {
+        if (!m_waited) {
+            waitChild(WNOHANG);
+        }
+        return m_waited;
+    }
+
+    /**
+    * @brief Wait for the reader
+    * @return exit code of the child process, -signal number if it was killed
+    */
+    int wait() {
+        if (!m_waited) {
+            waitChild(0);
+        }
+        return WIFEXITED(m_status) ? WEXITSTATUS(m_status) : -WTERMSIG(m_status);
+    }
+
+    /**
+    * @brief Waits for the reader, so the child doesn't become a zombie
+    */
+    ~ForkSnapshot() noexcept {
+        try {
+            wait();
+        } catch (...) {}
+    }
+
+private:
+    void waitChild(int options) {
+        pid_t res;
+        do {
+            res = ::waitpid(m_pid, &m_status, options);
+        } while (res < 0 && errno == EINTR);
+        if (res < 0) {
+            throw std::system_error(errno, std::generic_category(), "indexed::ForkSnapshot waitpid failed");
+        }
+        m_waited = (res == m_pid);
+    }
+
+    pid_t m_pid;
+    int m_status;
+    bool m_waited;
+};
+
+}
@@ -0,0 +1,332 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/NewAlloc.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace indexed {
+
+/**
+* @brief Header of the FrozenMap buffer, followed by the keys and the values in Eytzinger order.
+*/
+struct FrozenMapHeader {
+    static constexpr uint32_t kVersion = 1;
+
+    char magic[8];            // "IDXFROZN"
+    uint32_t version;
+    uint32_t headerSize;      // sizeof(FrozenMapHeader)
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint64_t count;           // number of elements
+    uint64_t keysOffset;      // offset of count + 1 keys, the first one is unused
+    uint64_t valuesOffset;    // offset of count + 1 values, the first one is unused
+    uint64_t bufferSize;
+};
+
+namespace detail {
+
+inline unsigned countTrailingOnes(uint64_t value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    return unsigned(__builtin_ctzll(~value));
+#else
+    unsigned count = 0;
+    for (; (value & 1) != 0; value >>= 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+constexpr size_t alignUp(size_t offset, size_t alignment) noexcept {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+}
+
+/**
+* @brief Immutable map in one buffer: sorted keys and values laid out in Eytzinger (BFS) order.
+*
+* freeze() copies the elements of a populated map, e.g. boost::container::map or boost::unordered_map
+* in an Arena, the lookups are then a branch-free binary search which touches one cache line per tree level
+* and prefetches the next levels, instead of chasing Node pointers. The buffer holds no addresses, so it can
+* be saved as is (data(), bufferSize()) and loaded with load(), or mapped from a file with MappedFileAlloc
+* and attach(), e.g. shared by processes via the page cache.
+* @tparam Key trivially copyable key type
+* @tparam Value trivially copyable value type
+* @tparam Alloc class responsible for the buffer allocation, e.g. NewAlloc, MappedFileAlloc
+* @tparam Compare ordering of the keys
+*/
+template <typename Key, typename Value, typename Alloc = NewAlloc, typename Compare = std::less<Key>>
+class FrozenMap : public Alloc {
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "indexed::FrozenMap Key and Value must be trivially copyable");
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+
+    /**
+    * @brief Create an empty FrozenMap, it has no buffer until freeze(), load() or attach()
+    */
+    explicit FrozenMap(Alloc&& alloc = Alloc(), const Compare& compare = Compare())
+    : Alloc(std::move(alloc))
+    , m_compare(compare)
+    , m_count(0)
+    , m_keysOffset(0)
+    , m_valuesOffset(0)
+    , m_bufferSize(0) {}
+
+    /**
+    * @brief Take the buffer of the other FrozenMap, it's left empty
+    */
+    FrozenMap(FrozenMap&& other)
+    : Alloc(std::move(static_cast<Alloc&>(other)))
+    , m_compare(other.m_compare)
+    , m_count(other.m_count)
+    , m_keysOffset(other.m_keysOffset)
+    , m_valuesOffset(other.m_valuesOffset)
+    , m_bufferSize(other.m_bufferSize) {
+        other.clear();
+    }
+
+    FrozenMap(const FrozenMap&) = delete;
+
+    /**
+    * @brief Release the buffer and take the buffer of the other FrozenMap, it's left empty
+    */
+    FrozenMap& operator=(FrozenMap&& other) {
+        if (this != &other) {
+            clear();
+            Alloc::operator=(std::move(static_cast<Alloc&>(other)));
+            m_compare = other.m_compare;
+            m_count = other.m_count;
+            m_keysOffset = other.m_keysOffset;
+            m_valuesOffset = other.m_valuesOffset;
+            m_bufferSize = other.m_bufferSize;
+            other.clear();
+        }
+        return *this;
+    }
+
+    FrozenMap& operator=(const FrozenMap&) = delete;
+
+    /**
+    * @brief Build the buffer from the elements, any previous buffer is released
+    * @param first begin of the range of pairs (key, value), it's sorted if needed, the keys must be unique
+    * @param last end of the range
+    */
+    template <typename Iterator>
+    void freeze(Iterator first, Iterator last) {
+        std::vector<std::pair<Key, Value>> sorted;
+        for (; first != last; ++first) {
+            sorted.emplace_back((*first).first, (*first).second);
+        }
+        auto less = [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) {
+            return m_compare(a.first, b.first);
+        };
+        if (!std::is_sorted(sorted.begin(), sorted.end(), less)) {
+            std::sort(sorted.begin(), sorted.end(), less);
+        }
+        if (std::adjacent_find(sorted.begin(), sorted.end(),
+                               [&less](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) {
+                                   return !less(a, b);
+                               }) != sorted.end()) {
+            throw std::invalid_argument("indexed::FrozenMap keys must be unique");
+        }
+
+        FrozenMapHeader header = FrozenMapHeader();
+        std::memcpy(header.magic, "IDXFROZN", sizeof(header.magic));
+        header.version = FrozenMapHeader::kVersion;
+        header.headerSize = sizeof(FrozenMapHeader);
+        header.keySize = sizeof(Key);
+        header.valueSize = sizeof(Value);
+        header.count = sorted.size();
+        header.keysOffset = detail::alignUp(sizeof(FrozenMapHeader), alignof(Key));
+        header.valuesOffset = detail::alignUp(size_t(header.keysOffset) + sizeof(Key) * (sorted.size() + 1),
+                                              alignof(Value));
+        header.bufferSize = header.valuesOffset + sizeof(Value) * (sorted.size() + 1);
+
+        clear();
+        Alloc::malloc(size_t(header.bufferSize));
+        char* buf = static_cast<char*>(Alloc::getPtr());
+        std::memset(buf, 0, size_t(header.bufferSize));
+        std::memcpy(buf, &header, sizeof(header));
+        adopt(header);
+        size_t next = 0;
+        fillEytzinger(sorted, next, 1);
+    }
+
+    /**
+    * @brief Build the buffer from all elements of the map
+    */
+    template <typename Map>
+    void freeze(const Map& map) { freeze(map.begin(), map.end()); }
+
+    /**
+    * @brief Copy the buffer saved from data(), any previous buffer is released.
+    * Throws std::runtime_error if it isn't a FrozenMap of these Key and Value.
+    */
+    void load(const void* data, size_t size) {
+        FrozenMapHeader header = checkHeader(data, size);
+        clear();
+        Alloc::malloc(size_t(header.bufferSize));
+        std::memcpy(Alloc::getPtr(), data, size_t(header.bufferSize));
+        adopt(header);
+    }
+
+    /**
+    * @brief Use the buffer provided by Alloc as is, e.g. a file mapped via MappedFileAlloc::mapFile().
+    * Throws std::runtime_error if it isn't a FrozenMap of these Key and Value.
+    * @param size size of the buffer in bytes
+    */
+    void attach(size_t size) {
+        clear();
+        Alloc::malloc(size);
+        try {
+            adopt(checkHeader(Alloc::getPtr(), size));
+        } catch (...) {
+            Alloc::free();
+            throw;
+        }
+    }
+
+    /**
+    * @brief Release the buffer
+    */
+    void clear() noexcept {
+        Alloc::free();
+        m_count = 0;
+        m_keysOffset = 0;
+        m_valuesOffset = 0;
+        m_bufferSize = 0;
+    }
+
+    /**
+    * @brief the buffer, nullptr if there is none
+    */
+    const void* data() const noexcept { return Alloc::getPtr(); }
+
+    /**
+    * @brief size of the buffer in bytes
+    */
+    size_t bufferSize() const noexcept { return m_bufferSize; }
+
+    size_t size() const noexcept { return m_count; }
+
+    bool empty() const noexcept { return m_count == 0; }
+
+    /**
+    * @brief Find the value of the key
+    * @return pointer to the value or nullptr if there is no such key
+    */
+    const Value* find(const Key& key) const noexcept {
+        size_t slot = findSlot(key);
+        return (slot != 0) ? values() + slot : nullptr;
+    }
+
+    size_t count(const Key& key) const noexcept { return (findSlot(key) != 0) ? 1 : 0; }
+
+    /**
+    * @brief Get the value of the key, throws std::out_of_range if there is no such key
+    */
+    const Value& at(const Key& key) const {
+        const Value* value = find(key);
+        if (value == nullptr) {
+            throw std::out_of_range("indexed::FrozenMap::at key not found");
+        }
+        return *value;
+    }
+
+private:
+    // the next levels of the search are 4 levels down, 16 keys in a row
+    static constexpr size_t kPrefetchMultiplier = 16;
+
+    const Key* keys() const noexcept {
+        return reinterpret_cast<const Key*>(static_cast<const char*>(Alloc::getPtr()) + m_keysOffset);
+    }
+
+    const Value* values() const noexcept {
+        return reinterpret_cast<const Value*>(static_cast<const char*>(Alloc::getPtr()) + m_valuesOffset);
+    }
+
+    // slot of the key in 1..count, 0 - not found
+    size_t findSlot(const Key& key) const noexcept {
+        const Key* keysPtr = keys();
+        size_t slot = 1;
+        while (slot <= m_count) {
+            indexed_prefetch(keysPtr + std::min(slot * kPrefetchMultiplier, m_count));
+            slot = 2 * slot + (m_compare(keysPtr[slot], key) ? 1 : 0);
+        }
+        // go up to the last node where the search turned left, it's the lower bound
+        slot >>= detail::countTrailingOnes(slot) + 1;
+        return (slot != 0 && !m_compare(key, keysPtr[slot])) ? slot : 0;
+    }
+
+    // in-order walk of the implicit tree assigns the sorted elements
+    void fillEytzinger(const std::vector<std::pair<Key, Value>>& sorted, size_t& next, size_t slot) noexcept {
+        if (slot > m_count) {
+            return;
+        }
+        fillEytzinger(sorted, next, 2 * slot);
+        char* buf = static_cast<char*>(Alloc::getPtr());
+        std::memcpy(buf + m_keysOffset + sizeof(Key) * slot, &sorted[next].first, sizeof(Key));
+        std::memcpy(buf + m_valuesOffset + sizeof(Value) * slot, &sorted[next].second, sizeof(Value));
+        ++next;
+        fillEytzinger(sorted, next, 2 * slot + 1);
+    }
+
+    static FrozenMapHeader checkHeader(const void* data, size_t size) {
+        FrozenMapHeader header;
+        if (data == nullptr || size < sizeof(header)) {
+            throw std::runtime_error("indexed::FrozenMap buffer is truncated");
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, "IDXFROZN", sizeof(header.magic)) != 0
+            || header.headerSize != sizeof(FrozenMapHeader)) {
+            throw std::runtime_error("indexed::FrozenMap buffer isn't a FrozenMap");
+        }
+        if (header.version != FrozenMapHeader::kVersion) {
+            throw std::runtime_error("indexed::FrozenMap version isn't supported");
+        }
+        if (header.keySize != sizeof(Key) || header.valueSize != sizeof(Value)) {
+            throw std::runtime_error("indexed::FrozenMap Key or Value type doesn't match");
+        }
+        if (header.bufferSize > size || header.count >= size
+            || header.keysOffset != detail::alignUp(sizeof(FrozenMapHeader), alignof(Key))
+            || header.valuesOffset < header.keysOffset + sizeof(Key) * (header.count + 1)
+            || header.valuesOffset % alignof(Value) != 0
+            || header.bufferSize < header.valuesOffset + sizeof(Value) * (header.count + 1)) {
+            throw std::runtime_error("indexed::FrozenMap buffer is truncated");
+        }
+        return header;
+    }
+
+    void adopt(const FrozenMapHeader& header) noexcept {
+        m_count = size_t(header.count);
+        m_keysOffset = size_t(header.keysOffset);
+        m_valuesOffset = size_t(header.valuesOffset);
+        m_bufferSize = size_t(header.bufferSize);
+    }
+
+    Compare m_compare;
+    size_t m_count;
+    size_t m_keysOffset;
+    size_t m_valuesOffset;
+    size_t m_bufferSize;
+};
+
+}
@@ -0,0 +1,127 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+namespace indexed {
+
+/**
+* @brief ArrayArena accepting deallocation from other threads via a lock-free inbox.
+*
+* The Arena is owned by one thread (the one which has created it or called setOwnerThread()), allocate()
+* and deallocate() in the owner thread are the fast ArrayArena ones. deallocate() in another thread pushes
+* the index to the inbox, a lock-free list stored in the freed objects themselves, so it doesn't allocate.
+* The owner drains the whole inbox with one exchange on its next allocate() when the inbox isn't empty,
+* or on drainInbox(). The objects freed remotely can be reused only after that.
+* Use it with SingleArenaConfigPerThread when objects are created in one thread and retired in another,
+* e.g. Allocator of the owner thread (it keeps the Arena pointer) deallocates in a worker thread.
+* Only deallocation is supported in other threads, they can't allocate or access Pointers via the config
+* of the owner thread.
+* @tparam Arena ArrayArena
+*/
+template <typename Arena>
+class InboxArena : public Arena {
+    static_assert(!Arena::kIsArrayArenaMT, "indexed::InboxArena is for ArrayArena, ArrayArenaMT is MT-safe");
+
+public:
+    using IndexType = typename Arena::IndexType;
+
+    /**
+    * @brief Create Arena owned by the calling thread, see ArrayArena::ArrayArena()
+    */
+    template <typename ...Args>
+    explicit InboxArena(Args&&... args)
+    : Arena(std::forward<Args>(args)...)
+    , m_owner(std::this_thread::get_id())
+    , m_inbox(0) {}
+
+    InboxArena(const InboxArena&) = delete;
+    InboxArena& operator=(const InboxArena&) = delete;
+
+    /**
+    * @brief Make the calling thread the owner of the Arena.
+    * NOTE The method is not MT-safe, call it before other threads can deallocate.
+    */
+    void setOwnerThread() noexcept { m_owner = std::this_thread::get_id(); }
+
+    /**
+    * @brief true if the calling thread is the owner of the Arena
+    */
+    bool isOwnerThread() const noexcept { return m_owner == std::this_thread::get_id(); }
+
+    /**
+    * @brief Allocate object in the Arena, only in the owner thread, see ArrayArena::allocate()
+    */
+    IndexType allocate(size_t typeSize) {
+        indexed_assert(isOwnerThread() && "indexed::InboxArena allocates in the owner thread only");
+        if (m_inbox.load(std::memory_order_relaxed) != 0) {
+            drainInbox(typeSize);
+        }
+        return Arena::allocate(typeSize);
+    }
+
+    /**
+    * @brief Allocate object without exceptions, only in the owner thread, see ArrayArena::tryAllocate()
+    */
+    IndexType tryAllocate(size_t typeSize) noexcept {
+        indexed_assert(isOwnerThread() && "indexed::InboxArena allocates in the owner thread only");
+        if (m_inbox.load(std::memory_order_relaxed) != 0) {
+            drainInbox(typeSize);
+        }
+        return Arena::tryAllocate(typeSize);
+    }
+
+    /**
+    * @brief Deallocate object in any thread, in another thread the index goes to the inbox
+    * @param index index of the object obtained in allocate()
+    * @param typeSize size of the object in bytes
+    */
+    void deallocate(IndexType index, size_t typeSize) noexcept {
+        if (isOwnerThread()) {
+            Arena::deallocate(index, typeSize);
+            return;
+        }
+        // not getElement(), its debug check reads usedCapacity changed by the owner
+        IndexType* slot = reinterpret_cast<IndexType*>(Arena::begin() + Arena::elementSize() * (index - 1));
+        IndexType head = m_inbox.load(std::memory_order_relaxed);
+        do {
+            *slot = head;
+        } while (!m_inbox.compare_exchange_weak(head, index, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /**
+    * @brief Release the objects deallocated in other threads, only in the owner thread
+    * @return number of released objects
+    */
+    size_t drainInbox() noexcept { return drainInbox(Arena::elementSize()); }
+
+    ~InboxArena() noexcept { drainInbox(); }
+
+private:
+    size_t drainInbox(size_t typeSize) noexcept {
+        IndexType index = m_inbox.exchange(0, std::memory_order_acquire);
+        size_t count = 0;
+        while (index != 0) {
+            IndexType next = *static_cast<IndexType*>(Arena::getElement(index));
+            Arena::deallocate(index, typeSize);
+            index = next;
+            ++count;
+        }
+        return count;
+    }
+
+    std::thread::id m_owner;
+    std::atomic<IndexType> m_inbox; // slist of objects deallocated in other threads
+};
+
+}
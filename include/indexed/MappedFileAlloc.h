@@ -0,0 +1,131 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArenaSnapshot.h>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace indexed {
+
+/**
+* @brief Helper class for ArrayArena. Maps a part of a file as the buffer, e.g. the objects of a snapshot.
+*
+* The file is set with mapFile() before the buffer is allocated. boost::interprocess::read_only gives
+* a frozen Arena, nothing may be allocated or deallocated then, copy_on_write (MAP_PRIVATE) lets
+* the process modify its private copy of the touched pages. In both modes the clean pages are shared
+* via the page cache by all processes mapping the file. The file must hold the whole buffer, mapping
+* beyond its end isn't allowed.
+*/
+class MappedFileAlloc {
+public:
+    MappedFileAlloc() = default;
+
+    /**
+    * @brief Set the file the buffer is mapped from
+    * @param path file name
+    * @param mode boost::interprocess::read_only or copy_on_write
+    * @param offset offset of the buffer in the file, any alignment
+    */
+    void mapFile(const char* path, boost::interprocess::mode_t mode, size_t offset) {
+        namespace bip = boost::interprocess;
+        if (mode != bip::read_only && mode != bip::copy_on_write) {
+            throw std::invalid_argument("indexed::MappedFileAlloc mode must be read_only or copy_on_write");
+        }
+        m_file = bip::file_mapping(path, bip::read_only);
+        m_mode = mode;
+        m_offset = offset;
+    }
+
+protected:
+    void malloc(size_t bytes) {
+        if (bytes == 0) {
+            throw std::bad_alloc();
+        }
+        m_memMapped = boost::interprocess::mapped_region(m_file, m_mode, boost::interprocess::offset_t(m_offset),
+                                                         bytes);
+    }
+
+    void* getPtr() const noexcept {
+        return m_memMapped.get_address();
+    }
+
+    void free() noexcept {
+        m_memMapped = boost::interprocess::mapped_region();
+    }
+
+private:
+    boost::interprocess::file_mapping m_file;
+    boost::interprocess::mode_t m_mode = boost::interprocess::read_only;
+    size_t m_offset = 0;
+    boost::interprocess::mapped_region m_memMapped;
+};
+
+/**
+* @brief Load a snapshot file made by saveSnapshot() without copying the objects: the Arena buffer is mapped.
+*
+* The Container object is copied to the container address (raw memory), call ArenaConfig::setContainer()
+* with it afterwards. The Arena capacity becomes the number of saved objects (usedCapacity),
+* in copy_on_write mode new objects reuse only the free slots of the snapshot.
+* In read_only mode the Container is frozen: don't modify or destroy it. The Arena keeps the saved
+* allocatedCount and free list (forEachLive() works), its deletion is off, so a deallocation never writes
+* to the mapping, nothing may be allocated (see MappedFileAlloc); call discard() on the Arena to drop
+* the frozen Container.
+* The objects are mapped at the padded dataOffset of the snapshot, so the Nodes are aligned.
+* The checksum is verified only on request, it reads the whole file.
+* @param arena ArrayArena with MappedFileAlloc, it must have no buffer yet
+* @param container memory for the Container object
+* @param containerSize size of the Container object, e.g. sizeof(Map)
+* @param path snapshot file name
+* @param mode boost::interprocess::read_only (frozen Arena) or copy_on_write
+* @param verifyChecksum true to verify the checksum
+*/
+template <typename Arena>
+void mapSnapshot(Arena& arena, void* container, size_t containerSize, const char* path,
+                 boost::interprocess::mode_t mode = boost::interprocess::read_only, bool verifyChecksum = false) {
+    namespace bip = boost::interprocess;
+    bip::file_mapping file(path, bip::read_only);
+    bip::mapped_region region(file, bip::read_only);
+    const char* in = static_cast<const char*>(region.get_address());
+    ArenaSnapshotHeader header;
+    if (region.get_size() < sizeof(header)) {
+        throw std::runtime_error("indexed::mapSnapshot snapshot is truncated");
+    }
+    std::memcpy(&header, in, sizeof(header));
+    detail::checkSnapshotHeader(header, containerSize);
+    if (region.get_size() < header.dataOffset || region.get_size() - header.dataOffset < header.dataSize) {
+        throw std::runtime_error("indexed::mapSnapshot snapshot is truncated");
+    }
+    if (verifyChecksum) {
+        detail::SnapshotChecksum checksum;
+        uint64_t stored = detail::headerChecksum(header, checksum);
+        checksum.update(in + sizeof(header), containerSize);
+        checksum.update(in + header.dataOffset, size_t(header.dataSize));
+        if (checksum.value() != stored) {
+            throw std::runtime_error("indexed::mapSnapshot checksum mismatch");
+        }
+    }
+    ArenaMetadata meta = header.arena;
+    meta.capacity = meta.usedCapacity;
+    if (mode == bip::read_only) {
+        // the free slots stay linked for forEachLive(), but deallocate() mustn't link more into the mapping
+        meta.deleteEnabled = 0;
+    }
+    if (meta.usedCapacity == 0) {
+        meta.elementSize = 0;
+    }
+    arena.mapFile(path, mode, size_t(header.dataOffset));
+    arena.restore(meta);
+    std::memcpy(container, in + sizeof(header), containerSize);
+}
+
+}
@@ -0,0 +1,69 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace indexed {
+
+namespace detail {
+
+/**
+* @brief Split [0, size) into parts, one per thread, and call f(begin, end) for every part.
+* The calling thread takes the first part. The first exception thrown by f is rethrown after all parts are done.
+* @param size size of the range
+* @param threads maximum number of threads
+* @param minPart minimal size of a part, smaller ranges use fewer threads
+* @param alignment part boundaries are multiples of it
+* @param f callable(size_t begin, size_t end)
+*/
+template <typename Func>
+void parallelFor(size_t size, unsigned threads, size_t minPart, size_t alignment, Func&& f) {
+    size_t maxThreads = std::max<size_t>(1, size / std::max<size_t>(minPart, 1));
+    size_t count = std::min<size_t>(std::max(threads, 1u), maxThreads);
+    size_t part = (size / count + alignment - 1) / alignment * alignment;
+    std::vector<std::exception_ptr> errors(count);
+    auto runPart = [&](size_t i) {
+        try {
+            size_t begin = std::min(size, i * part);
+            size_t end = (i + 1 == count) ? size : std::min(size, begin + part);
+            f(begin, end);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(count - 1);
+    try {
+        for (size_t i = 1; i < count; ++i) {
+            workers.emplace_back(runPart, i);
+        }
+    } catch (...) {
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        throw;
+    }
+    runPart(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}
+
+}
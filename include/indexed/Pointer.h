@@ -44,6 +44,17 @@ public:
         return m_index;
     }
 
+    /**
+    * @brief Prefetch the pointed object into CPU cache, no-op for nullptr.
+    * Index to address conversion doesn't read memory except the config data,
+    * so several prefetches can be issued before the first object is used.
+    */
+    void prefetch() const noexcept {
+        if (m_index != 0) {
+            indexed_prefetch(ArenaConfig::getElement(m_index));
+        }
+    }
+
     /**
     * @brief Get index integer (e.g. for atomic update)
     */
@@ -0,0 +1,223 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+#include <new>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace indexed {
+
+/**
+* @brief Header of the Arena trace file, followed by ArenaTraceEvent records, native byte order
+*/
+struct ArenaTraceHeader {
+    static constexpr uint32_t kVersion = 1;
+
+    char magic[8];      // "IDXTRACE"
+    uint32_t version;   // kVersion
+    uint32_t indexSize; // sizeof(IndexType) of the recorded Arena
+    uint64_t capacity;  // capacity of the recorded Arena
+};
+
+enum class ArenaTraceOp : uint8_t { Allocate = 0, Deallocate = 1, BadAlloc = 2 };
+
+/**
+* @brief Arena trace record, 8 bytes
+*/
+struct ArenaTraceEvent {
+    uint32_t index;     // index returned by allocate(), 0 for BadAlloc
+    uint32_t opAndSize; // object size in bytes << 8 | ArenaTraceOp
+
+    ArenaTraceOp op() const noexcept { return ArenaTraceOp(opAndSize & 0xff); }
+
+    size_t size() const noexcept { return opAndSize >> 8; }
+};
+
+/**
+* @brief Buffered writer of the Arena trace file, thread-safe
+*/
+class ArenaTraceWriter {
+public:
+    static constexpr size_t kBufferEvents = 4096;
+
+    /**
+    * @brief Create the trace file and write the header
+    * @param fileName trace file name, an existing file is overwritten
+    * @param indexSize sizeof(IndexType) of the recorded Arena
+    * @param capacity capacity of the recorded Arena
+    */
+    ArenaTraceWriter(const std::string& fileName, size_t indexSize, size_t capacity)
+    : m_file(std::fopen(fileName.c_str(), "wb")) {
+        if (!m_file) {
+            throw std::runtime_error("indexed::ArenaTraceWriter can't create " + fileName);
+        }
+        ArenaTraceHeader header;
+        std::memcpy(header.magic, "IDXTRACE", sizeof(header.magic));
+        header.version = ArenaTraceHeader::kVersion;
+        header.indexSize = uint32_t(indexSize);
+        header.capacity = capacity;
+        if (std::fwrite(&header, sizeof(header), 1, m_file) != 1) {
+            std::fclose(m_file);
+            throw std::runtime_error("indexed::ArenaTraceWriter can't write " + fileName);
+        }
+        m_buffer.reserve(kBufferEvents);
+    }
+
+    ArenaTraceWriter(const ArenaTraceWriter&) = delete;
+    ArenaTraceWriter& operator=(const ArenaTraceWriter&) = delete;
+
+    void write(ArenaTraceOp op, size_t index, size_t size) noexcept {
+        ArenaTraceEvent event;
+        event.index = uint32_t(index);
+        event.opAndSize = uint32_t(size << 8) | uint32_t(op);
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_buffer.push_back(event);
+        if (m_buffer.size() == kBufferEvents) {
+            flushInt();
+        }
+    }
+
+    void flush() noexcept {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        flushInt();
+        std::fflush(m_file);
+    }
+
+    ~ArenaTraceWriter() noexcept {
+        flushInt();
+        std::fclose(m_file);
+    }
+
+private:
+    void flushInt() noexcept {
+        size_t written = std::fwrite(m_buffer.data(), sizeof(ArenaTraceEvent), m_buffer.size(), m_file);
+        indexed_warning(written == m_buffer.size() && "indexed::ArenaTraceWriter failed to write events");
+        (void)written;
+        m_buffer.clear();
+    }
+
+    std::FILE* m_file;
+    std::mutex m_mutex;
+    std::vector<ArenaTraceEvent> m_buffer;
+};
+
+/**
+* @brief Read the whole Arena trace file written by RecordingArena
+* @param fileName trace file name
+* @param header [out] header of the file
+* @return events in the recorded order
+*/
+inline std::vector<ArenaTraceEvent> readArenaTrace(const std::string& fileName, ArenaTraceHeader& header) {
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> file(std::fopen(fileName.c_str(), "rb"), &std::fclose);
+    if (!file) {
+        throw std::runtime_error("indexed::readArenaTrace can't open " + fileName);
+    }
+    if (std::fread(&header, sizeof(header), 1, file.get()) != 1
+        || std::memcmp(header.magic, "IDXTRACE", sizeof(header.magic)) != 0) {
+        throw std::runtime_error("indexed::readArenaTrace " + fileName + " is not an Arena trace");
+    }
+    if (header.version != ArenaTraceHeader::kVersion) {
+        throw std::runtime_error("indexed::readArenaTrace " + fileName + " has unsupported version");
+    }
+    std::vector<ArenaTraceEvent> events;
+    ArenaTraceEvent chunk[ArenaTraceWriter::kBufferEvents];
+    size_t count;
+    while ((count = std::fread(chunk, sizeof(ArenaTraceEvent), ArenaTraceWriter::kBufferEvents, file.get())) > 0) {
+        events.insert(events.end(), chunk, chunk + count);
+    }
+    return events;
+}
+
+/**
+* @brief Arena recording allocate() / deallocate() events to a trace file: ArrayArena or ArrayArenaMT.
+*
+* Drop-in replacement of the Arena in ArenaConfig, like StatsArena. Recording is off until startRecording(),
+* then every event costs a locked append to a memory buffer, the buffer is written to the file
+* when it's full. The trace is replayed offline against other Arena variants (Bench replay) to choose
+* capacity and index type from a real workload.
+* For ArrayArenaMT deallocation is recorded before the index is released and allocation after it's taken,
+* so the trace order is consistent: an index is never allocated twice without a deallocation in between.
+* NOTE startRecording() / stopRecording() are not MT-safe, call them when no other thread uses the Arena.
+* @tparam Arena ArrayArena or ArrayArenaMT
+*/
+template <typename Arena>
+class RecordingArena : public Arena {
+public:
+    using IndexType = typename Arena::IndexType;
+
+    using Arena::Arena;
+
+    /**
+    * @brief Start recording to a new trace file, the previous recording is stopped
+    * @param fileName trace file name, an existing file is overwritten
+    */
+    void startRecording(const std::string& fileName) {
+        m_writer.reset();
+        m_writer.reset(new ArenaTraceWriter(fileName, sizeof(IndexType), Arena::capacity()));
+    }
+
+    /**
+    * @brief Stop recording, flush and close the trace file
+    */
+    void stopRecording() noexcept { m_writer.reset(); }
+
+    bool isRecording() const noexcept { return m_writer != nullptr; }
+
+    /**
+    * @brief Allocate object in the Arena, see Arena::allocate()
+    */
+    IndexType allocate(size_t typeSize) {
+        IndexType index;
+        try {
+            index = Arena::allocate(typeSize);
+        } catch (const std::bad_alloc&) {
+            if (m_writer) {
+                m_writer->write(ArenaTraceOp::BadAlloc, 0, typeSize);
+            }
+            throw;
+        }
+        if (m_writer) {
+            m_writer->write(ArenaTraceOp::Allocate, index, typeSize);
+        }
+        return index;
+    }
+
+    /**
+    * @brief Allocate object in the Arena without exceptions, see Arena::tryAllocate()
+    */
+    IndexType tryAllocate(size_t typeSize) noexcept {
+        IndexType index = Arena::tryAllocate(typeSize);
+        if (m_writer) {
+            m_writer->write((index != 0) ? ArenaTraceOp::Allocate : ArenaTraceOp::BadAlloc, index, typeSize);
+        }
+        return index;
+    }
+
+    /**
+    * @brief Deallocate object allocated before with the Arena, see Arena::deallocate()
+    */
+    void deallocate(IndexType index, size_t typeSize) noexcept {
+        if (m_writer) {
+            m_writer->write(ArenaTraceOp::Deallocate, index, typeSize);
+        }
+        Arena::deallocate(index, typeSize);
+    }
+
+private:
+    std::unique_ptr<ArenaTraceWriter> m_writer;
+};
+
+}
@@ -0,0 +1,338 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/ArrayArenaMT.h>
+
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace indexed {
+
+/**
+* @brief Thread and process-safe Arena in named POSIX shared memory (boost::interprocess::shared_memory_object).
+*
+* The segment starts with the Arena header: capacity, element size, free list head and used capacity,
+* then the root area for user data (e.g. the Container object) and the objects. Every process maps
+* the segment at its own address, the indices are the same in all processes. One process creates the
+* segment, the others attach to it by name. The segment lives until remove() is called.
+* Unlike ArrayArenaMT, the element size is given on creation, since the segment is sized then,
+* objects of any size up to elementSize() can be allocated.
+* To share a Container between processes place it in root(), use SingleArenaConfigUniversal with
+* kObjectSize <= rootSize() (the Container is found by offset from root() in every process) and
+* ConfigArenaPtr as ArenaPtr of the config (the Allocator inside the Container must not keep an address).
+* Every process calls setArena(), setContainer(root()) of the config with its own ShmArenaMT object.
+* The free list is the lock-free list of ArrayArenaMT, its atomics are lock-free, so they work across processes.
+* NOTE A process which dies between allocate() and publishing the object leaks the object.
+* @tparam Index unsigned integer type used for pointer representation: uint16_t or uint32_t
+*/
+template <typename Index>
+class ShmArenaMT {
+    static_assert(std::is_same<Index, uint16_t>::value ||
+                  std::is_same<Index, uint32_t>::value, "Index must be uint16_t or uint32_t");
+
+public:
+    using IndexType = Index;
+
+    static constexpr bool kIsArrayArenaMT = true;
+
+    static constexpr size_t kDefaultRootSize = 256;
+
+    /**
+    * @brief Create the shared memory segment, fails if it exists
+    * @param name segment name, e.g. "my_app_arena"
+    * @param capacity capacity in objects
+    * @param elementSize max size of objects in bytes, multiple of sizeof(Index)
+    * @param rootSize size in bytes of the user area before the objects, see root()
+    */
+    ShmArenaMT(boost::interprocess::create_only_t, const char* name, size_t capacity, size_t elementSize,
+               size_t rootSize = kDefaultRootSize) {
+        create(name, capacity, elementSize, rootSize);
+    }
+
+    /**
+    * @brief Attach to the existing segment created by another ShmArenaMT
+    * @param name segment name
+    */
+    ShmArenaMT(boost::interprocess::open_only_t, const char* name) {
+        open(name);
+    }
+
+    /**
+    * @brief Attach to the segment or create it, the parameters must match the existing segment
+    */
+    ShmArenaMT(boost::interprocess::open_or_create_t, const char* name, size_t capacity, size_t elementSize,
+               size_t rootSize = kDefaultRootSize) {
+        try {
+            create(name, capacity, elementSize, rootSize);
+        } catch (const boost::interprocess::interprocess_exception& ex) {
+            if (ex.get_error_code() != boost::interprocess::already_exists_error) {
+                throw;
+            }
+            open(name);
+            if (m_header->capacity != capacity || m_header->elementSize != elementSize
+                || m_header->rootSize != rootSize) {
+                throw std::runtime_error(std::string("indexed::ShmArenaMT segment ") + name
+                                         + " exists with different parameters");
+            }
+        }
+    }
+
+    ShmArenaMT(const ShmArenaMT&) = delete;
+    ShmArenaMT& operator=(const ShmArenaMT&) = delete;
+
+    /**
+    * @brief Remove the segment name, the memory is released when all processes unmap it
+    * @return true if the segment has been removed
+    */
+    static bool remove(const char* name) noexcept {
+        return boost::interprocess::shared_memory_object::remove(name);
+    }
+
+    /**
+    * @brief user area in the segment, it's not touched by the Arena
+    */
+    void* root() const noexcept { return static_cast<char*>(m_region.get_address()) + rootOffset(); }
+
+    /**
+    * @brief size of root() in bytes
+    */
+    size_t rootSize() const noexcept { return m_header->rootSize; }
+
+    /**
+    * @brief start of the objects memory in this process
+    */
+    char* begin() const noexcept { return m_begin; }
+
+    /**
+    * @brief end of the objects memory in this process
+    */
+    char* end() const noexcept { return m_begin + m_elementSize * m_capacity; }
+
+    /**
+    * @brief capacity of the Arena
+    */
+    size_t capacity() const noexcept { return m_capacity; }
+
+    /**
+    * @brief peek size ever reached, not MT-safe (mostly for debug)
+    */
+    size_t usedCapacity() const noexcept { return m_header->usedCapacity; }
+
+    /**
+    * @brief size of allocated memory objects in bytes
+    */
+    size_t elementSize() const noexcept { return m_elementSize; }
+
+    /**
+    * @brief number of failed CAS on the free list, always 0 unless INDEXED_CAS_STATS=1 (mostly for benchmarks)
+    */
+    size_t casRetryCount() const noexcept { return m_header->freeList.casRetryCount(); }
+
+    /**
+    * @brief always true, objects are reused after deallocate()
+    */
+    bool deleteIsEnabled() const noexcept { return true; }
+
+    /**
+    * @brief get pointer of object by index
+    * @param index index returned by the Arena allocate()
+    */
+    void* getElement(Index index) const noexcept {
+        indexed_assert(index > 0 && index <= m_capacity && "indexed::Pointer is invalid");
+        return m_begin + m_elementSize * (index - 1);
+    }
+
+    /**
+    * @brief Converts pointer to index
+    * @param ptr pointer to element allocated with the Arena
+    * @return index of the element in the Arena
+    */
+    Index pointer_to(const void* ptr) const noexcept {
+        size_t offset = static_cast<const char*>(ptr) - m_begin;
+        Index pos = Index(uint32_t(offset / sizeof(Index)) / m_elementSizeInIndex);
+        indexed_assert(m_elementSize * pos == offset
+            && "Attempt to create indexed::Pointer pointing inside an allocated Node, do you use iterator-> ?");
+        return pos + 1;
+    }
+
+    /**
+    * @brief Allocate object in the Arena
+    * @param typeSize size of the object in bytes, up to elementSize()
+    * @return index assigned to the allocated object
+    */
+    Index allocate(size_t typeSize) {
+        Index index = tryAllocate(typeSize);
+        if (index == 0) {
+            throw std::bad_alloc();
+        }
+        return index;
+    }
+
+    /**
+    * @brief Allocate object in the Arena, don't throw when the Arena is full
+    * @param typeSize size of the object in bytes, up to elementSize()
+    * @return index assigned to the allocated object or 0 on failure
+    */
+    Index tryAllocate(size_t typeSize) noexcept {
+        indexed_assert(typeSize <= m_elementSize && "indexed::ShmArenaMT elementSize is too small for the object");
+        (void)typeSize;
+        Index index = m_header->freeList.pull(*this);
+        if (index == 0) {
+            Index futureCapacity = ++m_header->usedCapacity;
+            if (futureCapacity > m_capacity) {
+                --m_header->usedCapacity;
+                indexed_trace(exhausted, this, m_capacity, typeSize);
+                return 0;
+            }
+            index = futureCapacity;
+        }
+        indexed_trace(allocate, this, index, typeSize);
+        return index;
+    }
+
+    /**
+    * @brief Deallocate object allocated before with the Arena
+    * @param index index of the object obtained in allocate()
+    * @param typeSize size of the object in bytes
+    */
+    void deallocate(Index index, size_t typeSize) noexcept {
+        indexed_trace(deallocate, this, index, typeSize);
+        (void)typeSize;
+        m_header->freeList.push(index, *this);
+    }
+
+    /**
+    * @brief Reset the Arena to the "new" state with no allocated objects, in all processes.
+    * NOTE You should be sure that there are no allocated objects or they will never be used.
+    * NOTE The method is not MT-safe, no other thread or process may use the Arena meanwhile.
+    */
+    void reset() noexcept {
+        indexed_trace(reset, this, usedCapacity(), 0);
+        m_header->freeList.reset();
+        m_header->usedCapacity = 0;
+    }
+
+    /**
+    * @brief Same as reset(), for abandon()
+    */
+    void discard() noexcept { reset(); }
+
+private:
+    using FreeList = detail::LockFreeSList<ShmArenaMT>;
+
+    static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+                  "indexed::ShmArenaMT needs lock-free atomics to share them between processes");
+
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kAlignment = 64;
+
+    // stored at the segment start
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t indexSize;
+        uint64_t capacity;
+        uint64_t elementSize;
+        uint64_t rootSize;
+        std::atomic<uint32_t> ready;
+        FreeList freeList;
+        std::atomic<Index> usedCapacity;
+    };
+
+    static size_t alignUp(size_t size) noexcept { return (size + kAlignment - 1) / kAlignment * kAlignment; }
+
+    static size_t rootOffset() noexcept { return alignUp(sizeof(Header)); }
+
+    static size_t dataOffset(size_t rootSize) noexcept { return alignUp(rootOffset() + rootSize); }
+
+    void create(const char* name, size_t capacity, size_t elementSize, size_t rootSize) {
+        namespace bip = boost::interprocess;
+        if (capacity >= (1u << (sizeof(Index) * 8 - 1))) {
+            throw std::length_error("indexed::ShmArenaMT capacity is too big for Index type");
+        }
+        if (elementSize == 0 || elementSize % sizeof(Index) != 0 || elementSize / sizeof(Index) > UINT16_MAX) {
+            throw std::invalid_argument("indexed::ShmArenaMT elementSize must be multiple of Index size");
+        }
+        m_shm = bip::shared_memory_object(bip::create_only, name, bip::read_write);
+        try {
+            m_shm.truncate(bip::offset_t(dataOffset(rootSize) + capacity * elementSize));
+            m_region = bip::mapped_region(m_shm, bip::read_write);
+        } catch (...) {
+            bip::shared_memory_object::remove(name);
+            throw;
+        }
+        m_header = ::new (m_region.get_address()) Header();
+        std::memcpy(m_header->magic, "IDXARENA", sizeof(m_header->magic));
+        m_header->version = kVersion;
+        m_header->indexSize = sizeof(Index);
+        m_header->capacity = capacity;
+        m_header->elementSize = elementSize;
+        m_header->rootSize = rootSize;
+        m_header->usedCapacity = 0;
+        attach();
+        m_header->ready.store(1, std::memory_order_release);
+    }
+
+    void open(const char* name) {
+        namespace bip = boost::interprocess;
+        using Clock = std::chrono::steady_clock;
+        m_shm = bip::shared_memory_object(bip::open_only, name, bip::read_write);
+        // the creator may be between shm_open and the header initialization
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        bip::offset_t size = 0;
+        while (!m_shm.get_size(size) || size_t(size) < sizeof(Header)) {
+            waitUntil(deadline, name);
+        }
+        m_region = bip::mapped_region(m_shm, bip::read_write);
+        m_header = static_cast<Header*>(m_region.get_address());
+        while (m_header->ready.load(std::memory_order_acquire) == 0) {
+            waitUntil(deadline, name);
+        }
+        if (std::memcmp(m_header->magic, "IDXARENA", sizeof(m_header->magic)) != 0 || m_header->version != kVersion
+            || m_header->indexSize != sizeof(Index)) {
+            throw std::runtime_error(std::string("indexed::ShmArenaMT segment ") + name
+                                     + " isn't an Arena of this Index type");
+        }
+        attach();
+    }
+
+    static void waitUntil(std::chrono::steady_clock::time_point deadline, const char* name) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            throw std::runtime_error(std::string("indexed::ShmArenaMT segment ") + name + " isn't initialized");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    void attach() noexcept {
+        m_begin = static_cast<char*>(m_region.get_address()) + dataOffset(m_header->rootSize);
+        m_capacity = Index(m_header->capacity);
+        m_elementSize = size_t(m_header->elementSize);
+        m_elementSizeInIndex = uint16_t(m_elementSize / sizeof(Index));
+    }
+
+    boost::interprocess::shared_memory_object m_shm;
+    boost::interprocess::mapped_region m_region;
+    Header* m_header = nullptr;
+    char* m_begin = nullptr;
+    Index m_capacity = 0;
+    uint16_t m_elementSizeInIndex = 0;
+    size_t m_elementSize = 0;
+};
+
+}
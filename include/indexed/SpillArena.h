@@ -0,0 +1,252 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+#include <new>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+namespace indexed {
+
+/**
+* @brief Arena spilling to a secondary Arena when the primary one is full, instead of bad_alloc.
+*
+* Indices 1..primaryCapacity belong to the primary Arena, the next secondaryCapacity indices
+* belong to the secondary one, so the Pointers of both look the same for ArenaConfig.
+* The usual setup is a primary Arena sized for the normal load and a secondary with MmapAlloc,
+* which only reserves memory for a spike until the first spilled object.
+* allocate() throws bad_alloc only when both Arenas are full, tryAllocate() returns 0 then.
+* Optional callbacks are called in the allocating thread:
+*  - soft watermark: the usedCapacity of the primary Arena has reached the given number of objects,
+*    it's checked on each allocation in the primary Arena, so a rearmed callback fires on the next one
+*    if usedCapacity is still at or above the watermark (it falls only when the primary Arena gets empty)
+*  - hard watermark: the primary Arena is full and the first object has spilled to the secondary one
+* Each callback is called once, until rearmWatermarks(), reset() or freeMemory(). They must not throw.
+* Set them before the allocations, setting is not MT-safe.
+* NOTE begin() / end() are the primary Arena buffer, SingleArenaConfigUniversal with kObjectSize == 0
+*      relies on them, use kObjectSize or SingleArenaConfig with SpillArena.
+* @tparam Primary ArrayArena or ArrayArenaMT
+* @tparam Secondary Arena with the same IndexType, e.g. ArrayArena with MmapAlloc
+*/
+template <typename Primary, typename Secondary = Primary>
+class SpillArena {
+    static_assert(std::is_same<typename Primary::IndexType, typename Secondary::IndexType>::value,
+                  "indexed::SpillArena Arenas must have the same IndexType");
+    static_assert(Primary::kIsArrayArenaMT == Secondary::kIsArrayArenaMT,
+                  "indexed::SpillArena Arenas must be both MT or both non-MT");
+
+public:
+    using IndexType = typename Primary::IndexType;
+    using Callback = std::function<void()>;
+
+    static constexpr bool kIsArrayArenaMT = Primary::kIsArrayArenaMT;
+
+    /**
+    * @brief Create Arena
+    * @param primaryCapacity capacity of the primary Arena in objects
+    * @param secondaryCapacity capacity of the secondary Arena in objects
+    * @param enableDelete see ArrayArena::enableDelete()
+    */
+    explicit SpillArena(size_t primaryCapacity = 0, size_t secondaryCapacity = 0, bool enableDelete = true)
+    : m_primary(0, enableDelete)
+    , m_secondary(0, enableDelete)
+    , m_primaryCapacity(0)
+    , m_softWatermark(0)
+    , m_softFired(false)
+    , m_hardFired(false) {
+        setCapacity(primaryCapacity, secondaryCapacity);
+    }
+
+    SpillArena(const SpillArena&) = delete;
+    SpillArena& operator=(const SpillArena&) = delete;
+
+    Primary& primary() noexcept { return m_primary; }
+
+    Secondary& secondary() noexcept { return m_secondary; }
+
+    /**
+    * @brief start of the primary Arena buffer
+    */
+    char* begin() const noexcept { return m_primary.begin(); }
+
+    /**
+    * @brief end of the primary Arena buffer
+    */
+    char* end() const noexcept { return m_primary.end(); }
+
+    /**
+    * @brief total capacity of both Arenas
+    */
+    size_t capacity() const noexcept { return m_primary.capacity() + m_secondary.capacity(); }
+
+    /**
+    * @brief peek size ever reached of both Arenas (mostly for debug)
+    */
+    size_t usedCapacity() const noexcept { return m_primary.usedCapacity() + m_secondary.usedCapacity(); }
+
+    /**
+    * @brief size of allocated memory objects in bytes
+    */
+    size_t elementSize() const noexcept {
+        return (m_primary.elementSize() != 0) ? m_primary.elementSize() : m_secondary.elementSize();
+    }
+
+    /**
+    * @brief number of objects in the secondary Arena's used capacity, non-zero means the load has spilled
+    */
+    size_t spilledCapacity() const noexcept { return m_secondary.usedCapacity(); }
+
+    /**
+    * @brief set capacities, must be done before the first allocation
+    * @param primaryCapacity capacity of the primary Arena in objects
+    * @param secondaryCapacity capacity of the secondary Arena in objects
+    */
+    void setCapacity(size_t primaryCapacity, size_t secondaryCapacity) {
+        if (primaryCapacity + secondaryCapacity >= (1u << (sizeof(IndexType) * 8 - 1))) {
+            throw std::length_error("indexed::SpillArena capacity is too big for Index type");
+        }
+        m_primary.setCapacity(primaryCapacity);
+        m_secondary.setCapacity(secondaryCapacity);
+        m_primaryCapacity = IndexType(primaryCapacity);
+    }
+
+    /**
+    * @brief Call the callback when the usedCapacity of the primary Arena reaches the given number of objects
+    * @param objects watermark in objects, 0 disables the callback
+    */
+    void setSoftWatermark(size_t objects, Callback callback) {
+        m_softWatermark = IndexType(objects);
+        m_onSoft = std::move(callback);
+    }
+
+    /**
+    * @brief Call the callback when the first object spills to the secondary Arena
+    */
+    void setHardWatermark(Callback callback) { m_onHard = std::move(callback); }
+
+    /**
+    * @brief Let the watermark callbacks be called again
+    */
+    void rearmWatermarks() noexcept {
+        m_softFired = false;
+        m_hardFired = false;
+    }
+
+    /**
+    * @brief get pointer of object by index
+    * @param index index returned by the Arena allocate()
+    */
+    void* getElement(IndexType index) const noexcept {
+        return (index <= m_primaryCapacity) ? m_primary.getElement(index)
+                                            : m_secondary.getElement(index - m_primaryCapacity);
+    }
+
+    /**
+    * @brief Converts pointer to index
+    * @param ptr pointer to element allocated with the Arena
+    * @return index of the element in the Arena
+    */
+    IndexType pointer_to(const void* ptr) const noexcept {
+        return (ptr >= m_primary.begin() && ptr < m_primary.end())
+               ? m_primary.pointer_to(ptr)
+               : IndexType(m_secondary.pointer_to(ptr) + m_primaryCapacity);
+    }
+
+    /**
+    * @brief Allocate object in the primary Arena or, when it's full, in the secondary one
+    * @param typeSize size of the object in bytes
+    * @return index assigned to the allocated object
+    */
+    IndexType allocate(size_t typeSize) {
+        IndexType index = tryAllocate(typeSize);
+        if (index == 0) {
+            throw std::bad_alloc();
+        }
+        return index;
+    }
+
+    /**
+    * @brief Allocate object like allocate(), but don't throw
+    * @param typeSize size of the object in bytes
+    * @return index assigned to the allocated object or 0 when both Arenas are full
+    */
+    IndexType tryAllocate(size_t typeSize) noexcept {
+        IndexType index = m_primary.tryAllocate(typeSize);
+        if (index != 0) {
+            if (m_softWatermark != 0 && m_onSoft && !m_softFired.load(std::memory_order_relaxed)
+                && m_primary.usedCapacity() >= m_softWatermark && !m_softFired.exchange(true)) {
+                m_onSoft();
+            }
+            return index;
+        }
+        index = m_secondary.tryAllocate(typeSize);
+        if (index == 0) {
+            return 0;
+        }
+        if (m_onHard && !m_hardFired.load(std::memory_order_relaxed) && !m_hardFired.exchange(true)) {
+            m_onHard();
+        }
+        return index + m_primaryCapacity;
+    }
+
+    /**
+    * @brief Deallocate object allocated before with the Arena
+    * @param index index of the object obtained in allocate()
+    * @param typeSize size of the object in bytes
+    */
+    void deallocate(IndexType index, size_t typeSize) noexcept {
+        if (index <= m_primaryCapacity) {
+            m_primary.deallocate(index, typeSize);
+        } else {
+            m_secondary.deallocate(index - m_primaryCapacity, typeSize);
+        }
+    }
+
+    /**
+    * @brief Reset both Arenas, see ArrayArena::reset()
+    */
+    void reset() noexcept {
+        m_primary.reset();
+        m_secondary.reset();
+        rearmWatermarks();
+    }
+
+    /**
+    * @brief Drop all objects of both Arenas in O(1), see ArrayArena::discard()
+    */
+    void discard() noexcept {
+        m_primary.discard();
+        m_secondary.discard();
+        rearmWatermarks();
+    }
+
+    /**
+    * @brief Reset both Arenas and release their memory, see ArrayArena::freeMemory()
+    */
+    void freeMemory() noexcept {
+        m_primary.freeMemory();
+        m_secondary.freeMemory();
+        rearmWatermarks();
+    }
+
+private:
+    Primary m_primary;
+    Secondary m_secondary;
+    IndexType m_primaryCapacity;
+    IndexType m_softWatermark;
+    std::atomic<bool> m_softFired;
+    std::atomic<bool> m_hardFired;
+    Callback m_onSoft;
+    Callback m_onHard;
+};
+
+}
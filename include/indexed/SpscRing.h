@@ -0,0 +1,149 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+
+#include <new>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace indexed {
+
+/**
+* @brief Single-producer single-consumer byte ring in the given memory, e.g. shared memory between processes.
+*
+* The memory holds the ring header (capacity and the byte counters of both sides) and the data.
+* One side creates the ring, the other attaches to the same memory, possibly at another address.
+* write() and read() block (spin with yield) until the whole data fits / arrives, so a full ring
+* applies backpressure to the producer. The counters are lock-free atomics, so they work across processes.
+*/
+class SpscRing {
+public:
+    /**
+    * @brief size of the memory needed for the ring of the given capacity
+    */
+    static size_t requiredBytes(size_t capacity) noexcept { return sizeof(Header) + capacity; }
+
+    /**
+    * @brief Create the ring in the memory
+    * @param memory memory of requiredBytes(capacity), aligned to 64 bytes
+    * @param capacity capacity of the ring in bytes
+    */
+    SpscRing(void* memory, size_t capacity)
+    : m_header(::new (memory) Header())
+    , m_data(static_cast<char*>(memory) + sizeof(Header))
+    , m_capacity(capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("indexed::SpscRing capacity can't be 0");
+        }
+        m_header->capacity = capacity;
+    }
+
+    /**
+    * @brief Attach to the ring created in the memory
+    * @param memory memory passed to the creating constructor (mapped in this process)
+    */
+    explicit SpscRing(void* memory) noexcept
+    : m_header(static_cast<Header*>(memory))
+    , m_data(static_cast<char*>(memory) + sizeof(Header))
+    , m_capacity(size_t(m_header->capacity)) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const noexcept { return m_capacity; }
+
+    /**
+    * @brief number of bytes ready to read, only in the consumer
+    */
+    size_t readable() const noexcept {
+        return size_t(m_header->written.load(std::memory_order_acquire) - m_header->read.load(std::memory_order_relaxed));
+    }
+
+    /**
+    * @brief Write the data, blocks while the ring is full, only in the producer
+    */
+    void write(const void* data, size_t size) noexcept {
+        const char* ptr = static_cast<const char*>(data);
+        uint64_t written = m_header->written.load(std::memory_order_relaxed);
+        while (size != 0) {
+            size_t space = m_capacity - size_t(written - m_header->read.load(std::memory_order_acquire));
+            if (space == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            size_t count = std::min(size, space);
+            copyIn(size_t(written % m_capacity), ptr, count);
+            written += count;
+            m_header->written.store(written, std::memory_order_release);
+            ptr += count;
+            size -= count;
+        }
+    }
+
+    /**
+    * @brief Read the data, blocks until it arrives, only in the consumer
+    */
+    void read(void* data, size_t size) noexcept {
+        char* ptr = static_cast<char*>(data);
+        uint64_t read = m_header->read.load(std::memory_order_relaxed);
+        while (size != 0) {
+            size_t available = size_t(m_header->written.load(std::memory_order_acquire) - read);
+            if (available == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            size_t count = std::min(size, available);
+            copyOut(size_t(read % m_capacity), ptr, count);
+            read += count;
+            m_header->read.store(read, std::memory_order_release);
+            ptr += count;
+            size -= count;
+        }
+    }
+
+private:
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "indexed::SpscRing needs lock-free atomics to work between processes");
+
+    // counters of both sides on separate cache lines
+    struct Header {
+        Header() noexcept
+        : capacity(0)
+        , written(0)
+        , read(0) {}
+
+        uint64_t capacity;
+        char pad0[56];
+        std::atomic<uint64_t> written;
+        char pad1[56];
+        std::atomic<uint64_t> read;
+        char pad2[56];
+    };
+
+    void copyIn(size_t pos, const char* from, size_t count) noexcept {
+        size_t first = std::min(count, m_capacity - pos);
+        std::memcpy(m_data + pos, from, first);
+        std::memcpy(m_data, from + first, count - first);
+    }
+
+    void copyOut(size_t pos, char* to, size_t count) const noexcept {
+        size_t first = std::min(count, m_capacity - pos);
+        std::memcpy(to, m_data + pos, first);
+        std::memcpy(to + first, m_data, count - first);
+    }
+
+    Header* m_header;
+    char* m_data;
+    size_t m_capacity;
+};
+
+}
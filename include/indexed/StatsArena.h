@@ -0,0 +1,229 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <indexed/Config.h>
+#include <indexed/CacheLine.h>
+
+#include <new>
+#include <cstdint>
+#include <atomic>
+#include <utility>
+#include <type_traits>
+
+namespace indexed {
+
+/**
+* @brief Snapshot of Arena statistics, see StatsArena::stats()
+*/
+struct ArenaStats {
+    size_t allocations = 0;     // successful allocate() calls
+    size_t deallocations = 0;   // deallocate() calls
+    size_t liveObjects = 0;     // allocations - deallocations
+    size_t highWaterMark = 0;   // max index ever allocated = peak usedCapacity, the capacity the workload needs,
+                                // it doesn't fall after deallocations and can exceed the peak of liveObjects
+    size_t usedCapacity = 0;    // objects taken from the buffer since the last reset
+    size_t freeListLength = 0;  // free (or leaked if deletion is off) slots within usedCapacity
+    size_t badAllocCount = 0;   // failed allocate() / tryAllocate() calls
+    size_t elementSize = 0;     // size of objects in bytes, 0 before the first allocation
+    size_t bytesCommitted = 0;  // size of the buffer allocated via Alloc, 0 before the first allocation
+    size_t bytesLive = 0;       // liveObjects * elementSize
+    double fragmentation = 0;   // freeListLength / usedCapacity, share of used slots which hold no object
+};
+
+namespace detail {
+
+// plain counters for ArrayArena, it's not thread-safe anyway
+class ArenaCounters {
+public:
+    void onAllocate(size_t index) noexcept {
+        ++m_allocations;
+        if (index > m_highWater) {
+            m_highWater = index;
+        }
+    }
+
+    void onDeallocate() noexcept { ++m_deallocations; }
+
+    void onBadAlloc() noexcept { ++m_badAllocs; }
+
+    void fill(ArenaStats& stats) const noexcept {
+        stats.allocations = m_allocations;
+        stats.deallocations = m_deallocations;
+        stats.badAllocCount = m_badAllocs;
+        stats.highWaterMark = m_highWater;
+    }
+
+    void clear() noexcept { *this = ArenaCounters(); }
+
+private:
+    size_t m_allocations = 0;
+    size_t m_deallocations = 0;
+    size_t m_badAllocs = 0;
+    size_t m_highWater = 0;
+};
+
+inline size_t nextCounterShard() noexcept {
+    static std::atomic<size_t> next(0);
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// shard of the calling thread, threads get shards round-robin
+inline size_t threadCounterShard() noexcept {
+    static thread_local size_t shard = nextCounterShard();
+    return shard;
+}
+
+// counters for ArrayArenaMT sharded by thread, every shard is on its own cache line, so threads don't
+// write the same line
+class ShardedArenaCounters {
+public:
+    static constexpr size_t kShards = 16;
+
+    ShardedArenaCounters() noexcept
+    : m_highWater(0) {}
+
+    ShardedArenaCounters(const ShardedArenaCounters&) = delete;
+    ShardedArenaCounters& operator=(const ShardedArenaCounters&) = delete;
+
+    void onAllocate(size_t index) noexcept {
+        local().allocations.fetch_add(1, std::memory_order_relaxed);
+        // index grows only when the free list is empty, so the CAS loop is rare
+        size_t highWater = m_highWater.load(std::memory_order_relaxed);
+        while (index > highWater && !m_highWater.compare_exchange_weak(highWater, index,
+                                                                       std::memory_order_relaxed)) {}
+    }
+
+    void onDeallocate() noexcept { local().deallocations.fetch_add(1, std::memory_order_relaxed); }
+
+    void onBadAlloc() noexcept { local().badAllocs.fetch_add(1, std::memory_order_relaxed); }
+
+    void fill(ArenaStats& stats) const noexcept {
+        for (size_t i = 0; i < kShards; ++i) {
+            const Shard& shard = m_shards[i];
+            stats.allocations += shard.allocations.load(std::memory_order_relaxed);
+            stats.deallocations += shard.deallocations.load(std::memory_order_relaxed);
+            stats.badAllocCount += shard.badAllocs.load(std::memory_order_relaxed);
+        }
+        stats.highWaterMark = m_highWater.load(std::memory_order_relaxed);
+    }
+
+    void clear() noexcept {
+        for (size_t i = 0; i < kShards; ++i) {
+            m_shards[i].allocations = 0;
+            m_shards[i].deallocations = 0;
+            m_shards[i].badAllocs = 0;
+        }
+        m_highWater = 0;
+    }
+
+private:
+    struct Shard {
+        Shard() noexcept
+        : allocations(0)
+        , deallocations(0)
+        , badAllocs(0) {}
+
+        std::atomic<size_t> allocations;
+        std::atomic<size_t> deallocations;
+        std::atomic<size_t> badAllocs;
+    };
+
+    Shard& local() noexcept { return m_shards[threadCounterShard() % kShards]; }
+
+    // aligned inside the object, so heap-allocated Arenas don't need aligned new
+    CacheLineArray<Shard, kShards> m_shards;
+    std::atomic<size_t> m_highWater;
+};
+
+}
+
+/**
+* @brief Arena with statistics: ArrayArena or ArrayArenaMT counting allocations, deallocations and failures.
+*
+* Drop-in replacement of the Arena in ArenaConfig, e.g. SingleArenaConfigStatic<StatsArena<ArrayArena<...>>, ...>.
+* Counting costs a few increments per allocate() / deallocate(), for ArrayArenaMT the counters are sharded
+* by thread and updated with relaxed atomics, so it's cheap enough to keep on in production.
+* stats() doesn't walk the free list, it's O(1) for ArrayArena and O(shards) for ArrayArenaMT.
+* For ArrayArenaMT the snapshot taken while other threads allocate is approximate (counters are read one by one).
+* NOTE ArrayArena resets itself when the last object is deallocated, usedCapacity drops to 0 then,
+*      while the counters and highWaterMark are kept until clearStats().
+* @tparam Arena ArrayArena or ArrayArenaMT
+*/
+template <typename Arena>
+class StatsArena : public Arena {
+public:
+    using IndexType = typename Arena::IndexType;
+
+    using Arena::Arena;
+
+    /**
+    * @brief Allocate object in the Arena, see Arena::allocate()
+    */
+    IndexType allocate(size_t typeSize) {
+        IndexType index;
+        try {
+            index = Arena::allocate(typeSize);
+        } catch (const std::bad_alloc&) {
+            m_counters.onBadAlloc();
+            throw;
+        }
+        m_counters.onAllocate(index);
+        return index;
+    }
+
+    /**
+    * @brief Allocate object in the Arena without exceptions, see Arena::tryAllocate()
+    */
+    IndexType tryAllocate(size_t typeSize) noexcept {
+        IndexType index = Arena::tryAllocate(typeSize);
+        if (index == 0) {
+            m_counters.onBadAlloc();
+        } else {
+            m_counters.onAllocate(index);
+        }
+        return index;
+    }
+
+    /**
+    * @brief Deallocate object allocated before with the Arena, see Arena::deallocate()
+    */
+    void deallocate(IndexType index, size_t typeSize) noexcept {
+        m_counters.onDeallocate();
+        Arena::deallocate(index, typeSize);
+    }
+
+    /**
+    * @brief Current statistics of the Arena
+    */
+    ArenaStats stats() const noexcept {
+        ArenaStats res;
+        m_counters.fill(res);
+        res.liveObjects = (res.allocations > res.deallocations) ? res.allocations - res.deallocations : 0;
+        res.usedCapacity = Arena::usedCapacity();
+        res.freeListLength = (res.usedCapacity > res.liveObjects) ? res.usedCapacity - res.liveObjects : 0;
+        res.elementSize = Arena::elementSize();
+        res.bytesCommitted = (Arena::begin() != nullptr) ? res.elementSize * Arena::capacity() : 0;
+        res.bytesLive = res.elementSize * res.liveObjects;
+        res.fragmentation = res.usedCapacity ? double(res.freeListLength) / double(res.usedCapacity) : 0.0;
+        return res;
+    }
+
+    /**
+    * @brief Zero the counters and highWaterMark, e.g. after reset() or freeMemory().
+    * NOTE The method is not MT-safe for ArrayArenaMT, call it when no other thread uses the Arena.
+    */
+    void clearStats() noexcept { m_counters.clear(); }
+
+private:
+    using Counters = typename std::conditional<Arena::kIsArrayArenaMT,
+                                               detail::ShardedArenaCounters, detail::ArenaCounters>::type;
+
+    Counters m_counters;
+};
+
+}
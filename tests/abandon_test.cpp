@@ -0,0 +1,121 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/Abandon.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+#include <boost/container/list.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = ArrayArena<uint32_t, NewAlloc>;
+using ArenaMT = ArrayArenaMT<uint32_t, NewAlloc>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigStatic<Arena, ArenaConfig> {};
+    struct ArenaConfigMT : public SingleArenaConfigUniversalStatic<ArenaMT, ArenaConfigMT, 64> {};
+
+    // counts the live objects
+    struct Payload {
+        static int live;
+
+        explicit Payload(int v)
+        : value(v) { ++live; }
+
+        Payload(const Payload& other)
+        : value(other.value) { ++live; }
+
+        ~Payload() { --live; }
+
+        int value;
+    };
+
+    int Payload::live = 0;
+}
+
+using Map = boost::container::map<int, int, std::less<int>, Allocator<pair<const int, int>, ArenaConfig>>;
+using PayloadMap = boost::container::map<int, Payload, std::less<int>, Allocator<pair<const int, Payload>, ArenaConfig>>;
+using ListMT = boost::container::list<int, Allocator<int, ArenaConfigMT>>;
+
+class AbandonTest : public ::testing::Test {
+protected:
+    Arena m_arena;
+
+    AbandonTest()
+    : m_arena(1000) {
+        ArenaConfig::setArena(&m_arena);
+        ArenaConfig::setStackTop(getThreadStackTop());
+    }
+};
+
+TEST_F(AbandonTest, trivialElements) {
+    Map map;
+    for (int i = 0; i < 500; ++i) {
+        map.emplace(i, -i);
+    }
+    map.erase(7);
+    EXPECT_EQ(500u, m_arena.usedCapacity());
+    abandon(map, m_arena);
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(0u, m_arena.usedCapacity());
+    EXPECT_EQ(0u, m_arena.allocatedCount());
+
+    // the Container and the Arena are reusable
+    for (int i = 0; i < 1000; ++i) {
+        map.emplace(i, i);
+    }
+    EXPECT_EQ(1000u, map.size());
+    EXPECT_EQ(999, (*map.find(999)).second);
+}
+
+TEST_F(AbandonTest, nonTrivialElements) {
+    Payload::live = 0;
+    {
+        PayloadMap map;
+        for (int i = 0; i < 300; ++i) {
+            map.emplace(i, Payload(i));
+        }
+        EXPECT_EQ(300, Payload::live);
+        abandon(map, m_arena);
+        EXPECT_EQ(0, Payload::live);
+        EXPECT_TRUE(map.empty());
+        EXPECT_EQ(0u, m_arena.allocatedCount());
+        map.emplace(1, Payload(1));
+        EXPECT_EQ(1, Payload::live);
+    }
+    EXPECT_EQ(0, Payload::live);
+}
+
+TEST(AbandonMTTest, listInArenaMT) {
+    ArenaMT arena(100);
+    ArenaConfigMT::setArena(&arena);
+    ArenaConfigMT::setStackTop(getThreadStackTop());
+    unique_ptr<ListMT> list(new ListMT());
+    for (int i = 0; i < 100; ++i) {
+        list->push_back(i);
+    }
+    EXPECT_THROW(list->push_back(100), std::bad_alloc);
+    abandon(*list, arena);
+    EXPECT_TRUE(list->empty());
+    for (int i = 0; i < 100; ++i) {
+        list->push_front(i);
+    }
+    EXPECT_EQ(99, list->front());
+}
@@ -0,0 +1,259 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/DirtyArena.h>
+#include <indexed/ArenaCheckpoint.h>
+#include <indexed/ConfigArenaPtr.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = DirtyArena<ArrayArena<uint32_t, NewAlloc>, 8>;
+using PlainArena = ArrayArena<uint32_t, NewAlloc>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigUniversalStatic<Arena, ArenaConfig> {
+        static constexpr bool kAssignContainerFollowingAllocator = false;
+
+        using ArenaPtr = ConfigArenaPtr<ArenaConfig>;
+
+        static ArenaPtr defaultArena() noexcept { return ArenaPtr(); }
+    };
+
+    struct PlainConfig : public SingleArenaConfigUniversalStatic<PlainArena, PlainConfig> {
+        static constexpr bool kAssignContainerFollowingAllocator = false;
+
+        using ArenaPtr = ConfigArenaPtr<PlainConfig>;
+
+        static ArenaPtr defaultArena() noexcept { return ArenaPtr(); }
+    };
+
+    struct TmpFile {
+        FILE* file = tmpfile();
+
+        ~TmpFile() { fclose(file); }
+
+        int fd() const { return fileno(file); }
+
+        int rewind() const { return int(lseek(fd(), 0, SEEK_SET)); }
+    };
+}
+
+using Key = int;
+using Value = int;
+using Pair = pair<const Key, Value>;
+using Map = boost::container::map<Key, Value, std::less<Key>, Allocator<Pair, ArenaConfig>>;
+using PlainMap = boost::container::map<Key, Value, std::less<Key>, Allocator<Pair, PlainConfig>>;
+using MapStorage = aligned_storage<sizeof(Map), alignof(Map)>::type;
+
+TEST(DirtyArenaTest, barrierAndTouch) {
+    constexpr size_t elementSize = 8;
+    DirtyArena<ArrayArenaMT<uint32_t, NewAlloc>, 4> arena(100);
+    EXPECT_EQ(DirtyTracking::Compare, arena.tracking());
+    ASSERT_TRUE(arena.setTracking(DirtyTracking::Barrier));
+    for (uint32_t i = 1; i <= 40; ++i) {
+        arena.allocate(elementSize);
+    }
+    EXPECT_EQ(4 * elementSize, arena.chunkBytes());
+    EXPECT_EQ(10u, arena.collectDirty());
+    arena.clearDirty();
+    EXPECT_EQ(0u, arena.collectDirty());
+
+    arena.deallocate(10, elementSize);
+    arena.touch(arena.getElement(30));
+    arena.touch(static_cast<char*>(arena.getElement(31)) + 4);
+    arena.touch(uint32_t(40));
+    EXPECT_EQ(3u, arena.collectDirty());
+    EXPECT_TRUE(arena.isDirty(2));
+    EXPECT_TRUE(arena.isDirty(7));
+    EXPECT_TRUE(arena.isDirty(9));
+    vector<size_t> offsets;
+    arena.forEachDirtyChunk([&](size_t offset, size_t size) {
+        offsets.push_back(offset);
+        EXPECT_EQ(arena.chunkBytes(), size);
+    });
+    EXPECT_EQ((vector<size_t>{8 * elementSize, 28 * elementSize, 36 * elementSize}), offsets);
+
+    // in-place writes are found by Compare
+    arena.clearDirty();
+    EXPECT_TRUE(arena.setTracking(DirtyTracking::Compare));
+    arena.clearDirty();
+    *static_cast<char*>(arena.getElement(17)) = 1;
+    EXPECT_EQ(1u, arena.collectDirty());
+    EXPECT_TRUE(arena.isDirty(4));
+
+    // SoftDirty needs kernel support, it isn't changed if it's missing
+    if (arena.setTracking(DirtyTracking::SoftDirty)) {
+        arena.clearDirty();
+        *static_cast<char*>(arena.getElement(1)) = 1;
+        EXPECT_LE(1u, arena.collectDirty());
+        EXPECT_TRUE(arena.isDirty(0));
+    } else {
+        EXPECT_EQ(DirtyTracking::Compare, arena.tracking());
+    }
+    for (uint32_t i = 1; i <= 40; ++i) {
+        if (i != 10) {
+            arena.deallocate(i, elementSize);
+        }
+    }
+}
+
+TEST(DirtyArenaTest, deltasCompactToSnapshot) {
+    Arena arena(1000);
+    ASSERT_TRUE(arena.setTracking(DirtyTracking::Compare));
+    unique_ptr<MapStorage> storage(new MapStorage);
+    ArenaConfig::setArena(&arena);
+    ArenaConfig::setStackTop(getThreadStackTop());
+    ArenaConfig::setContainer(storage.get());
+    Map* map = ::new (storage.get()) Map();
+    for (int i = 0; i < 500; ++i) {
+        map->emplace(i, i);
+    }
+
+    TmpFile base, delta1, delta2, out;
+    saveSnapshot(arena, map, sizeof(Map), base.fd());
+    arena.clearDirty();
+
+    // in-place update and new nodes
+    (*map->find(10)).second = -10;
+    for (int i = 500; i < 520; ++i) {
+        map->emplace(i, i);
+    }
+    size_t chunks1 = saveDelta(arena, map, sizeof(Map), delta1.fd());
+    EXPECT_LT(0u, chunks1);
+    EXPECT_GT((arena.usedCapacity() + 7) / 8, chunks1);
+
+    for (int i = 0; i < 100; ++i) {
+        map->erase(i);
+    }
+    saveDelta(arena, map, sizeof(Map), delta2.fd());
+    EXPECT_EQ(0u, saveDelta(arena, map, sizeof(Map), out.fd()));
+    ASSERT_EQ(0, ftruncate(out.fd(), 0));
+    ASSERT_EQ(0, out.rewind());
+
+    ASSERT_EQ(0, base.rewind());
+    ASSERT_EQ(0, delta1.rewind());
+    ASSERT_EQ(0, delta2.rewind());
+    compactSnapshot(base.fd(), {delta1.fd(), delta2.fd()}, out.fd());
+
+    PlainArena loaded;
+    unique_ptr<MapStorage> loadedStorage(new MapStorage);
+    ASSERT_EQ(0, out.rewind());
+    loadSnapshot(loaded, loadedStorage.get(), sizeof(Map), out.fd());
+    PlainConfig::setArena(&loaded);
+    PlainConfig::setStackTop(getThreadStackTop());
+    PlainConfig::setContainer(loadedStorage.get());
+    PlainMap& copy = *reinterpret_cast<PlainMap*>(loadedStorage.get());
+    EXPECT_EQ(map->size(), copy.size());
+    EXPECT_TRUE(equal(map->begin(), map->end(), copy.begin()));
+    EXPECT_EQ(memcmp(arena.begin(), loaded.begin(), arena.usedCapacity() * arena.elementSize()), 0);
+    copy.clear();
+    copy.~PlainMap();
+    map->~Map();
+}
+
+TEST(DirtyArenaTest, barrierMissesNodeLinks) {
+    // insert and erase rewrite the links of old nodes, only Compare (the default) sees them
+    for (DirtyTracking tracking : {DirtyTracking::Barrier, DirtyTracking::Compare}) {
+        Arena arena(1000);
+        ASSERT_TRUE(arena.setTracking(tracking));
+        unique_ptr<MapStorage> storage(new MapStorage);
+        ArenaConfig::setArena(&arena);
+        ArenaConfig::setStackTop(getThreadStackTop());
+        ArenaConfig::setContainer(storage.get());
+        Map* map = ::new (storage.get()) Map();
+        for (int i = 0; i < 200; ++i) {
+            map->emplace(2 * i, i);
+        }
+        TmpFile base, delta, out;
+        saveSnapshot(arena, map, sizeof(Map), base.fd());
+        arena.clearDirty();
+        for (int i = 1; i < 100; i += 2) {
+            map->emplace(i, i);
+        }
+        for (int i = 100; i < 150; ++i) {
+            map->erase(i);
+        }
+        saveDelta(arena, map, sizeof(Map), delta.fd());
+        ASSERT_EQ(0, base.rewind());
+        ASSERT_EQ(0, delta.rewind());
+        compactSnapshot(base.fd(), {delta.fd()}, out.fd());
+
+        PlainArena loaded;
+        unique_ptr<MapStorage> loadedStorage(new MapStorage);
+        ASSERT_EQ(0, out.rewind());
+        loadSnapshot(loaded, loadedStorage.get(), sizeof(Map), out.fd());
+        bool identical = memcmp(arena.begin(), loaded.begin(), arena.usedCapacity() * arena.elementSize()) == 0;
+        if (tracking == DirtyTracking::Barrier) {
+            EXPECT_FALSE(identical);
+            loaded.discard(); // the loaded map is corrupted, it's not traversed
+        } else {
+            EXPECT_TRUE(identical);
+            PlainConfig::setArena(&loaded);
+            PlainConfig::setStackTop(getThreadStackTop());
+            PlainConfig::setContainer(loadedStorage.get());
+            PlainMap& copy = *reinterpret_cast<PlainMap*>(loadedStorage.get());
+            EXPECT_EQ(map->size(), copy.size());
+            EXPECT_TRUE(equal(map->begin(), map->end(), copy.begin()));
+            copy.clear();
+            copy.~PlainMap();
+        }
+        map->~Map();
+    }
+}
+
+TEST(DirtyArenaTest, corruptedDelta) {
+    Arena arena(100);
+    unique_ptr<MapStorage> storage(new MapStorage);
+    ArenaConfig::setArena(&arena);
+    ArenaConfig::setStackTop(getThreadStackTop());
+    ArenaConfig::setContainer(storage.get());
+    Map* map = ::new (storage.get()) Map();
+    TmpFile base, delta, out;
+    saveSnapshot(arena, map, sizeof(Map), base.fd());
+    arena.clearDirty();
+    map->emplace(1, 1);
+    saveDelta(arena, map, sizeof(Map), delta.fd());
+    map->~Map();
+
+    char byte;
+    off_t end = lseek(delta.fd(), 0, SEEK_END);
+    ASSERT_EQ(1, pread(delta.fd(), &byte, 1, end - 12));
+    byte ^= 1;
+    ASSERT_EQ(1, pwrite(delta.fd(), &byte, 1, end - 12));
+    ASSERT_EQ(0, base.rewind());
+    ASSERT_EQ(0, delta.rewind());
+    EXPECT_THROW(compactSnapshot(base.fd(), {delta.fd()}, out.fd()), std::runtime_error);
+    EXPECT_EQ(0, lseek(out.fd(), 0, SEEK_END));
+
+    // the metadata is checked before the data size is computed from it
+    ArenaDeltaHeader header;
+    ASSERT_EQ(ssize_t(sizeof(header)), pread(delta.fd(), &header, sizeof(header), 0));
+    header.arena.usedCapacity = header.arena.capacity = UINT64_MAX / header.arena.elementSize;
+    ASSERT_EQ(ssize_t(sizeof(header)), pwrite(delta.fd(), &header, sizeof(header), 0));
+    ASSERT_EQ(0, base.rewind());
+    ASSERT_EQ(0, delta.rewind());
+    EXPECT_THROW(compactSnapshot(base.fd(), {delta.fd()}, out.fd()), std::runtime_error);
+}
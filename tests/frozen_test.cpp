@@ -0,0 +1,161 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/MappedFileAlloc.h>
+#include <indexed/FrozenMap.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = ArrayArena<uint32_t, NewAlloc>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigStatic<Arena, ArenaConfig> {};
+}
+
+using Key = int;
+using Value = double;
+using Pair = pair<const Key, Value>;
+using Alloc = Allocator<Pair, ArenaConfig>;
+using Map = boost::container::map<Key, Value, std::less<Key>, Alloc>;
+using UnorderedMap = boost::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>, Alloc>;
+using Frozen = FrozenMap<Key, Value>;
+
+class FrozenMapTest : public ::testing::Test {
+protected:
+    Arena m_arena;
+
+    FrozenMapTest()
+    : m_arena(2000) {
+        ArenaConfig::setArena(&m_arena);
+        ArenaConfig::setStackTop(getThreadStackTop());
+    }
+
+    // keys 3 * i, i in [0, count)
+    template <typename FrozenType>
+    static void checkLookups(const FrozenType& frozen, int count) {
+        ASSERT_EQ(size_t(count), frozen.size());
+        for (int i = -1; i <= 3 * count; ++i) {
+            const Value* value = frozen.find(i);
+            if (i >= 0 && i % 3 == 0 && i < 3 * count) {
+                ASSERT_NE(nullptr, value) << i;
+                EXPECT_EQ(i * 0.5, *value);
+                EXPECT_EQ(1u, frozen.count(i));
+            } else {
+                EXPECT_EQ(nullptr, value) << i;
+                EXPECT_EQ(0u, frozen.count(i));
+            }
+        }
+    }
+};
+
+TEST_F(FrozenMapTest, freezeMap) {
+    // sizes around the powers of two give complete and partial last levels
+    for (int count : {0, 1, 2, 3, 7, 8, 9, 100, 1000}) {
+        Map map; // on stack, see SingleArenaConfig
+        for (int i = 0; i < count; ++i) {
+            map.emplace(3 * i, i * 1.5);
+        }
+        Frozen frozen;
+        EXPECT_EQ(nullptr, frozen.find(0));
+        frozen.freeze(map);
+        checkLookups(frozen, count);
+        if (count > 1) {
+            EXPECT_EQ(1.5, frozen.at(3));
+        }
+        EXPECT_THROW(frozen.at(1), std::out_of_range);
+    }
+}
+
+TEST_F(FrozenMapTest, freezeUnorderedMap) {
+    // boost::unordered_map may be on heap with SingleArenaConfig
+    unique_ptr<UnorderedMap> map(new UnorderedMap());
+    for (int i = 0; i < 500; ++i) {
+        map->emplace(3 * i, i * 1.5);
+    }
+    Frozen frozen;
+    frozen.freeze(*map);
+    checkLookups(frozen, 500);
+
+    vector<pair<Key, Value>> duplicates = {{1, 1.0}, {2, 2.0}, {1, 3.0}};
+    EXPECT_THROW(frozen.freeze(duplicates.begin(), duplicates.end()), std::invalid_argument);
+}
+
+TEST_F(FrozenMapTest, loadAndMapBuffer) {
+    vector<pair<Key, Value>> elements;
+    for (int i = 0; i < 300; ++i) {
+        elements.emplace_back(3 * i, i * 1.5);
+    }
+    Frozen frozen;
+    frozen.freeze(elements.begin(), elements.end());
+    const char* data = static_cast<const char*>(frozen.data());
+    vector<char> buf(data, data + frozen.bufferSize());
+
+    Frozen loaded;
+    loaded.load(buf.data(), buf.size());
+    checkLookups(loaded, 300);
+    EXPECT_THROW(loaded.load(buf.data(), buf.size() - 1), std::runtime_error);
+    using OtherValue = FrozenMap<Key, float>;
+    OtherValue other;
+    EXPECT_THROW(other.load(buf.data(), buf.size()), std::runtime_error);
+
+    // the buffer is mapped from a file after a file header
+    char path[] = "/tmp/indexed_frozen_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    const string prefix = "prefix";
+    ASSERT_EQ(ssize_t(prefix.size()), write(fd, prefix.data(), prefix.size()));
+    ASSERT_EQ(ssize_t(buf.size()), write(fd, buf.data(), buf.size()));
+    close(fd);
+    {
+        FrozenMap<Key, Value, MappedFileAlloc> mapped;
+        mapped.mapFile(path, boost::interprocess::read_only, prefix.size());
+        mapped.attach(buf.size());
+        checkLookups(mapped, 300);
+        FrozenMap<Key, Value, MappedFileAlloc> moved(std::move(mapped));
+        checkLookups(moved, 300);
+        EXPECT_EQ(nullptr, mapped.data());
+    }
+    unlink(path);
+}
+
+TEST_F(FrozenMapTest, move) {
+    vector<pair<Key, Value>> elements;
+    for (int i = 0; i < 100; ++i) {
+        elements.emplace_back(3 * i, i * 1.5);
+    }
+    Frozen frozen;
+    frozen.freeze(elements.begin(), elements.end());
+    Frozen moved(std::move(frozen));
+    checkLookups(moved, 100);
+    checkLookups(frozen, 0);
+    EXPECT_EQ(nullptr, frozen.data());
+    EXPECT_EQ(0u, frozen.bufferSize());
+
+    frozen.freeze(elements.begin(), elements.begin() + 10);
+    moved = std::move(frozen);
+    checkLookups(moved, 10);
+    checkLookups(frozen, 0);
+    EXPECT_EQ(nullptr, frozen.data());
+}
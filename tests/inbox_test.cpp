@@ -0,0 +1,105 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/InboxArena.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = InboxArena<ArrayArena<uint32_t, NewAlloc>>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigPerThread<Arena, ArenaConfig> {};
+
+    struct Item {
+        uint32_t value;
+        uint32_t pad;
+    };
+}
+
+TEST(InboxArenaTest, remoteFreeIsReusedAfterDrain) {
+    Arena arena(4);
+    uint32_t a = arena.allocate(8);
+    uint32_t b = arena.allocate(8);
+    thread([&arena, a] {
+        EXPECT_FALSE(arena.isOwnerThread());
+        arena.deallocate(a, 8);
+    }).join();
+    EXPECT_EQ(arena.allocatedCount(), 2u);
+    EXPECT_EQ(arena.allocate(8), a);
+    EXPECT_EQ(arena.allocatedCount(), 2u);
+    arena.deallocate(a, 8);
+    arena.deallocate(b, 8);
+    EXPECT_EQ(arena.allocatedCount(), 0u);
+}
+
+TEST(InboxArenaTest, drainInbox) {
+    Arena arena(8);
+    vector<uint32_t> indices;
+    for (int i = 0; i < 8; ++i) {
+        indices.push_back(arena.allocate(8));
+    }
+    thread([&arena, &indices] {
+        for (uint32_t index : indices) {
+            arena.deallocate(index, 8);
+        }
+    }).join();
+    EXPECT_EQ(arena.drainInbox(), 8u);
+    EXPECT_EQ(arena.allocatedCount(), 0u);
+    EXPECT_EQ(arena.usedCapacity(), 0u);
+}
+
+TEST(InboxArenaTest, producerConsumer) {
+    constexpr size_t kItems = 100000;
+    constexpr size_t kInFlight = 64;
+    Arena arena(kInFlight + 1);
+    ArenaConfig::setArena(&arena);
+    ArenaConfig::setStackTop(getThreadStackTop());
+    Allocator<Item, ArenaConfig> alloc;
+    using Ptr = Allocator<Item, ArenaConfig>::pointer;
+
+    vector<Ptr> queue(kInFlight);
+    atomic<size_t> produced(0);
+    atomic<size_t> consumed(0);
+    thread consumer([&arena, &queue, &produced, &consumed, alloc] {
+        for (size_t k = 0; k < kItems; ++k) {
+            while (produced.load(memory_order_acquire) == k) {
+                this_thread::yield();
+            }
+            // the consumer thread has no Arena in its config, items are accessed by raw pointers
+            Item* base = reinterpret_cast<Item*>(arena.begin());
+            Ptr ptr = queue[k % kInFlight];
+            EXPECT_EQ(base[ptr.get() - 1].value, uint32_t(k));
+            alloc.deallocate(ptr, 1);
+            consumed.store(k + 1, memory_order_release);
+        }
+    });
+    for (size_t k = 0; k < kItems; ++k) {
+        while (k - consumed.load(memory_order_acquire) == kInFlight) {
+            this_thread::yield();
+        }
+        Ptr ptr = alloc.allocate(1);
+        ptr->value = uint32_t(k);
+        queue[k % kInFlight] = ptr;
+        produced.store(k + 1, memory_order_release);
+    }
+    consumer.join();
+    arena.drainInbox();
+    EXPECT_EQ(arena.allocatedCount(), 0u);
+    ArenaConfig::setArena(nullptr);
+}
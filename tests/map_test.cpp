@@ -19,6 +19,7 @@
 #include <initializer_list>
 #include <memory>
 #include <algorithm>
+#include <vector>
 
 using namespace indexed;
 using namespace std;
@@ -0,0 +1,159 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/MappedFileAlloc.h>
+#include <indexed/ArenaSnapshot.h>
+#include <indexed/ArenaScan.h>
+#include <indexed/ConfigArenaPtr.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+
+using namespace indexed;
+using namespace std;
+
+namespace bip = boost::interprocess;
+
+using Arena = ArrayArena<uint32_t, NewAlloc>;
+using MappedArena = ArrayArena<uint32_t, MappedFileAlloc>;
+
+namespace {
+    template <typename ArenaType>
+    struct ArenaConfig : public SingleArenaConfigUniversalStatic<ArenaType, ArenaConfig<ArenaType>> {
+        static constexpr bool kAssignContainerFollowingAllocator = false;
+
+        using ArenaPtr = ConfigArenaPtr<ArenaConfig>;
+
+        static ArenaPtr defaultArena() noexcept { return ArenaPtr(); }
+    };
+}
+
+using Key = int;
+using Value = int;
+using Pair = pair<const Key, Value>;
+
+// Maps differ only in the Arena's Alloc, their layout is the same
+template <typename ArenaType>
+using Map = boost::container::map<Key, Value, std::less<Key>, Allocator<Pair, ArenaConfig<ArenaType>>>;
+
+using ArenaMap = Map<Arena>;
+using MappedMap = Map<MappedArena>;
+using MapStorage = aligned_storage<sizeof(Map<Arena>), alignof(Map<Arena>)>::type;
+
+static_assert(sizeof(Map<Arena>) == sizeof(Map<MappedArena>), "Map layouts differ");
+
+class MappedSnapshotTest : public ::testing::Test {
+protected:
+    string m_path;
+
+    // build the map with NewAlloc and save its snapshot to the file
+    MappedSnapshotTest()
+    : m_path("/tmp/indexed_mapped_test_" + to_string(getpid())) {
+        Arena arena(1000);
+        unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+        MapStorage& storage = *storageOnHeap;
+        use(arena, &storage);
+        Map<Arena>* map = ::new (&storage) Map<Arena>();
+        for (int i = 0; i < 500; ++i) {
+            map->emplace(i, i * 10);
+        }
+        map->erase(7);
+        int fd = ::open(m_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0600);
+        EXPECT_NE(-1, fd);
+        saveSnapshot(arena, map, sizeof(*map), fd);
+        ::close(fd);
+        map->~ArenaMap();
+    }
+
+    ~MappedSnapshotTest() { ::unlink(m_path.c_str()); }
+
+    template <typename ArenaType>
+    static void use(ArenaType& arena, void* container) {
+        ArenaConfig<ArenaType>::setArena(&arena);
+        ArenaConfig<ArenaType>::setStackTop(getThreadStackTop());
+        ArenaConfig<ArenaType>::setContainer(container);
+    }
+};
+
+TEST_F(MappedSnapshotTest, readOnly) {
+    MappedArena arena;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    mapSnapshot(arena, &storage, sizeof(Map<MappedArena>), m_path.c_str(), bip::read_only, true);
+    use(arena, &storage);
+    const Map<MappedArena>& map = *reinterpret_cast<Map<MappedArena>*>(&storage);
+    EXPECT_EQ(499u, map.size());
+    EXPECT_EQ(500u, arena.capacity());
+    EXPECT_TRUE(map.find(7) == map.end());
+    EXPECT_EQ(4990, (*map.find(499)).second);
+    int sum = 0;
+    for (const auto& pair : map) {
+        sum += pair.first;
+    }
+    EXPECT_EQ(499 * 500 / 2 - 7, sum);
+    // the frozen Arena keeps its objects and free list
+    EXPECT_EQ(499u, arena.allocatedCount());
+    EXPECT_FALSE(arena.deleteIsEnabled());
+    size_t live = 0;
+    forEachLive(arena, [&live](uint32_t, void*) { ++live; });
+    EXPECT_EQ(499u, live);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(arena.begin()) % ArenaSnapshotHeader::kDataAlignment);
+    // the frozen map is dropped without destructor
+    arena.discard();
+}
+
+TEST_F(MappedSnapshotTest, copyOnWrite) {
+    {
+        MappedArena arena;
+        unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+        MapStorage& storage = *storageOnHeap;
+        mapSnapshot(arena, &storage, sizeof(Map<MappedArena>), m_path.c_str(), bip::copy_on_write);
+        use(arena, &storage);
+        Map<MappedArena>& map = *reinterpret_cast<Map<MappedArena>*>(&storage);
+        (*map.find(1)).second = -1;
+        map.emplace(7, 70); // reuses the free slot
+        EXPECT_THROW(map.emplace(1000, 0), std::bad_alloc);
+        EXPECT_EQ(500u, map.size());
+        EXPECT_EQ(-1, (*map.find(1)).second);
+        map.~MappedMap();
+    }
+    // the file isn't changed
+    MappedArena arena;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    mapSnapshot(arena, &storage, sizeof(Map<MappedArena>), m_path.c_str(), bip::read_only, true);
+    use(arena, &storage);
+    const Map<MappedArena>& map = *reinterpret_cast<Map<MappedArena>*>(&storage);
+    EXPECT_EQ(10, (*map.find(1)).second);
+    EXPECT_TRUE(map.find(7) == map.end());
+    arena.discard();
+}
+
+TEST_F(MappedSnapshotTest, errors) {
+    MappedArena arena;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    EXPECT_THROW(mapSnapshot(arena, &storage, sizeof(Map<MappedArena>) + 8, m_path.c_str()), std::runtime_error);
+    EXPECT_THROW(mapSnapshot(arena, &storage, sizeof(Map<MappedArena>), "/tmp/indexed_mapped_test_missing"),
+                 bip::interprocess_exception);
+    ASSERT_EQ(0, ::truncate(m_path.c_str(), 200));
+    EXPECT_THROW(mapSnapshot(arena, &storage, sizeof(Map<MappedArena>), m_path.c_str()), std::runtime_error);
+    EXPECT_EQ(nullptr, arena.begin());
+}
@@ -115,3 +115,22 @@ TEST_F(PointerTest, usePointerOnStack) {
     *ptr = 2;
     EXPECT_EQ(v, 2);
 }
+
+TEST_F(PointerTest, prefetch) {
+    Allocator<int, ArenaConfig> alloc;
+    Pointer<int, ArenaConfig> ptr = alloc.allocate(1);
+    *ptr = 5;
+    auto index = ptr.get();
+    ptr.prefetch();
+    EXPECT_EQ(index, ptr.get());
+    EXPECT_EQ(5, *ptr);
+    Pointer<int, ArenaConfig> null(nullptr);
+    null.prefetch();
+    EXPECT_TRUE(null == nullptr);
+    int v = 1;
+    auto stackPtr = Pointer<int, ArenaConfig>::pointer_to(v);
+    stackPtr.prefetch();
+    EXPECT_EQ(stackPtr.operator->(), &v);
+    EXPECT_EQ(1, v);
+    alloc.deallocate(ptr, 1);
+}
@@ -0,0 +1,152 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/ArenaPublisher.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = ArrayArena<uint32_t, NewAlloc>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigUniversalPerThread<Arena, ArenaConfig> {
+        static constexpr bool kAssignContainerFollowingAllocator = false;
+    };
+}
+
+using Key = int;
+using Value = int;
+using Pair = pair<const Key, Value>;
+using Alloc = Allocator<Pair, ArenaConfig>;
+using Map = boost::container::map<Key, Value, std::less<Key>, Alloc>;
+using MapStorage = aligned_storage<sizeof(Map), alignof(Map)>::type;
+using Publisher = ArenaPublisher<ArenaConfig>;
+
+namespace {
+    constexpr int kMapSize = 1000;
+
+    // map of generation g: keys [g, g + kMapSize), every value is g
+    struct Table {
+        Arena arena;
+        MapStorage storage;
+
+        explicit Table(int generation)
+        : arena(kMapSize) {
+            use();
+            Map* map = ::new (&storage) Map();
+            for (int i = 0; i < kMapSize; ++i) {
+                map->emplace(generation + i, generation);
+            }
+        }
+
+        ~Table() {
+            use();
+            reinterpret_cast<Map*>(&storage)->~Map();
+        }
+
+        void use() {
+            ArenaConfig::setArena(&arena);
+            ArenaConfig::setContainer(&storage);
+        }
+    };
+}
+
+TEST(ArenaPublisherTest, readersSeeWholeVersions) {
+    constexpr int generations = 20;
+    ArenaConfig::setStackTop(getThreadStackTop());
+    unique_ptr<Table> table(new Table(0));
+    Publisher publisher(&table->arena, &table->storage);
+
+    atomic<bool> stop(false);
+    atomic<int> errors(0);
+    vector<thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&]() {
+            ArenaConfig::setStackTop(getThreadStackTop());
+            Publisher::Reader reader(publisher);
+            int seen = 0;
+            while (!stop.load()) {
+                Publisher::ReadLock lock(reader);
+                const Map& map = *static_cast<const Map*>(lock.container());
+                int generation = (*map.begin()).first;
+                if (generation < seen || map.size() != size_t(kMapSize)) {
+                    ++errors;
+                }
+                seen = generation;
+                for (int i = 0; i < kMapSize; i += 7) {
+                    auto it = map.find(generation + i);
+                    if (it == map.end() || (*it).second != generation) {
+                        ++errors;
+                    }
+                }
+            }
+        });
+    }
+
+    for (int generation = 1; generation <= generations; ++generation) {
+        unique_ptr<Table> next(new Table(generation));
+        Publisher::Version old = publisher.publish(&next->arena, &next->storage);
+        EXPECT_EQ(&table->arena, old.arena);
+        EXPECT_EQ(static_cast<void*>(&table->storage), old.container);
+        // the grace period is over, nobody reads the old table
+        table = std::move(next);
+    }
+    stop = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, errors.load());
+    EXPECT_EQ(&table->arena, publisher.current().arena);
+}
+
+TEST(ArenaPublisherTest, readerSlots) {
+    using SmallPublisher = ArenaPublisher<ArenaConfig, 2>;
+    Arena arena;
+    SmallPublisher publisher(&arena, nullptr);
+    {
+        SmallPublisher::Reader first(publisher);
+        SmallPublisher::Reader second(publisher);
+        EXPECT_THROW(SmallPublisher::Reader{publisher}, std::length_error);
+        SmallPublisher::ReadLock lock(first);
+        EXPECT_EQ(&arena, ArenaConfig::getArena());
+        EXPECT_EQ(nullptr, lock.container());
+    }
+    // the slots are released
+    SmallPublisher::Reader third(publisher);
+}
+
+TEST(CacheLineArrayTest, alignedOnHeap) {
+    struct Owner {
+        char first;
+        detail::CacheLineArray<atomic<int>, 5> counters;
+    };
+    for (int i = 0; i < 8; ++i) {
+        unique_ptr<Owner> owner(new Owner());
+        for (size_t j = 0; j < owner->counters.size(); ++j) {
+            uintptr_t address = reinterpret_cast<uintptr_t>(&owner->counters[j]);
+            EXPECT_EQ(0u, address % detail::kCacheLineSize);
+            EXPECT_LE(reinterpret_cast<uintptr_t>(owner.get()) + 1, address);
+            EXPECT_GE(reinterpret_cast<uintptr_t>(owner.get() + 1), address + detail::kCacheLineSize);
+            EXPECT_EQ(0, owner->counters[j].load());
+        }
+    }
+}
@@ -0,0 +1,98 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/RecordingArena.h>
+#include <indexed/NewAlloc.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+namespace {
+    const char kTraceFile[] = "recording_test.trace";
+}
+
+class RecordingTest : public ::testing::Test {
+protected:
+    ~RecordingTest() { std::remove(kTraceFile); }
+};
+
+TEST_F(RecordingTest, recordsEvents) {
+    RecordingArena<ArrayArena<uint16_t, NewAlloc>> arena(2);
+    uint16_t a = arena.allocate(8);
+    arena.startRecording(kTraceFile);
+    EXPECT_TRUE(arena.isRecording());
+    uint16_t b = arena.allocate(8);
+    EXPECT_THROW(arena.allocate(8), bad_alloc);
+    arena.deallocate(b, 8);
+    arena.stopRecording();
+    arena.deallocate(a, 8);
+
+    ArenaTraceHeader header;
+    vector<ArenaTraceEvent> events = readArenaTrace(kTraceFile, header);
+    EXPECT_EQ(header.indexSize, 2u);
+    EXPECT_EQ(header.capacity, 2u);
+    ASSERT_EQ(events.size(), 3u);
+    EXPECT_EQ(events[0].op(), ArenaTraceOp::Allocate);
+    EXPECT_EQ(events[0].index, b);
+    EXPECT_EQ(events[0].size(), 8u);
+    EXPECT_EQ(events[1].op(), ArenaTraceOp::BadAlloc);
+    EXPECT_EQ(events[2].op(), ArenaTraceOp::Deallocate);
+    EXPECT_EQ(events[2].index, b);
+}
+
+TEST_F(RecordingTest, traceIsConsistentMT) {
+    constexpr size_t kThreads = 4;
+    constexpr size_t kOps = 20000;
+    RecordingArena<ArrayArenaMT<uint32_t, NewAlloc>> arena(kThreads * 8);
+    arena.startRecording(kTraceFile);
+    vector<thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&arena] {
+            for (size_t k = 0; k < kOps; ++k) {
+                arena.deallocate(arena.allocate(16), 16);
+            }
+        });
+    }
+    for (thread& th : threads) {
+        th.join();
+    }
+    arena.stopRecording();
+    arena.reset();
+
+    ArenaTraceHeader header;
+    vector<ArenaTraceEvent> events = readArenaTrace(kTraceFile, header);
+    ASSERT_EQ(events.size(), 2 * kThreads * kOps);
+    set<uint32_t> live;
+    for (const ArenaTraceEvent& event : events) {
+        if (event.op() == ArenaTraceOp::Allocate) {
+            EXPECT_TRUE(live.insert(event.index).second);
+        } else {
+            EXPECT_EQ(live.erase(event.index), 1u);
+        }
+    }
+    EXPECT_TRUE(live.empty());
+}
+
+TEST_F(RecordingTest, rejectsWrongFile) {
+    ArenaTraceHeader header;
+    EXPECT_THROW(readArenaTrace("no_such_file.trace", header), runtime_error);
+    FILE* file = fopen(kTraceFile, "wb");
+    fputs("not a trace", file);
+    fclose(file);
+    EXPECT_THROW(readArenaTrace(kTraceFile, header), runtime_error);
+}
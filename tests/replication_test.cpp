@@ -0,0 +1,192 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/DirtyArena.h>
+#include <indexed/ArenaReplication.h>
+#include <indexed/ConfigArenaPtr.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using LeaderArena = DirtyArena<ArrayArena<uint32_t, NewAlloc>>;
+using FollowerArena = ArrayArena<uint32_t, NewAlloc>;
+
+namespace {
+    template <typename ArenaType>
+    struct ArenaConfig : public SingleArenaConfigUniversalStatic<ArenaType, ArenaConfig<ArenaType>> {
+        static constexpr bool kAssignContainerFollowingAllocator = false;
+
+        using ArenaPtr = ConfigArenaPtr<ArenaConfig>;
+
+        static ArenaPtr defaultArena() noexcept { return ArenaPtr(); }
+    };
+}
+
+using Key = int;
+using Value = int;
+using Pair = pair<const Key, Value>;
+
+template <typename ArenaType>
+using Map = boost::container::map<Key, Value, std::less<Key>, Allocator<Pair, ArenaConfig<ArenaType>>>;
+
+using LeaderMap = Map<LeaderArena>;
+using FollowerMap = Map<FollowerArena>;
+using MapStorage = aligned_storage<sizeof(LeaderMap), alignof(LeaderMap)>::type;
+
+TEST(SpscRingTest, wrapAround) {
+    constexpr size_t capacity = 10;
+    vector<uint64_t> memory(SpscRing::requiredBytes(capacity) / sizeof(uint64_t) + 1);
+    SpscRing producer(memory.data(), capacity);
+    SpscRing consumer(memory.data());
+    EXPECT_EQ(capacity, consumer.capacity());
+    EXPECT_EQ(0u, consumer.readable());
+
+    thread reader([&]() {
+        for (int i = 0; i < 1000; ++i) {
+            int value[3];
+            consumer.read(value, sizeof(value));
+            EXPECT_EQ(i, value[0]);
+            EXPECT_EQ(-i, value[2]);
+        }
+    });
+    for (int i = 0; i < 1000; ++i) {
+        int value[3] = {i, 0, -i};
+        producer.write(value, sizeof(value));
+    }
+    reader.join();
+    EXPECT_EQ(0u, consumer.readable());
+}
+
+TEST(ReplicationTest, followerIsByteIdentical) {
+    constexpr size_t capacity = 2000;
+    constexpr int rounds = 20;
+    // a small ring, the deltas wrap and the leader waits for the follower
+    constexpr size_t ringCapacity = 4096;
+    vector<uint64_t> ringMemory(SpscRing::requiredBytes(ringCapacity) / sizeof(uint64_t) + 1);
+    SpscRing leaderRing(ringMemory.data(), ringCapacity);
+
+    LeaderArena leader(capacity);
+    ASSERT_TRUE(leader.setTracking(DirtyTracking::Compare));
+    unique_ptr<MapStorage> leaderStorage(new MapStorage);
+    ArenaConfig<LeaderArena>::setArena(&leader);
+    ArenaConfig<LeaderArena>::setStackTop(getThreadStackTop());
+    ArenaConfig<LeaderArena>::setContainer(leaderStorage.get());
+    LeaderMap* map = ::new (leaderStorage.get()) LeaderMap();
+    for (int i = 0; i < 500; ++i) {
+        map->emplace(i, i);
+    }
+
+    FollowerArena follower;
+    unique_ptr<MapStorage> followerStorage(new MapStorage);
+    thread followerThread([&]() {
+        SpscRing ring(ringMemory.data());
+        ArenaConfig<FollowerArena>::setArena(&follower);
+        ArenaConfig<FollowerArena>::setStackTop(getThreadStackTop());
+        ArenaConfig<FollowerArena>::setContainer(followerStorage.get());
+        const FollowerMap& replica = *reinterpret_cast<FollowerMap*>(followerStorage.get());
+        for (int applied = 0; applied <= rounds; ) {
+            if (!applyReplicatedDelta(follower, followerStorage.get(), sizeof(FollowerMap), ring)) {
+                this_thread::yield();
+                continue;
+            }
+            // every delta gives a consistent map: round r has keys [r, 500 + r)
+            EXPECT_EQ(500u, replica.size());
+            EXPECT_EQ(applied, (*replica.begin()).first);
+            EXPECT_EQ(applied * 1000, (*replica.begin()).second);
+            ++applied;
+        }
+    });
+
+    (*map->begin()).second = 0;
+    leader.markAllDirty();
+    replicateDelta(leader, map, sizeof(LeaderMap), leaderRing);
+    for (int round = 1; round <= rounds; ++round) {
+        map->erase(round - 1);
+        map->emplace(500 + round - 1, 0);
+        (*map->begin()).second = round * 1000;
+        size_t chunks = replicateDelta(leader, map, sizeof(LeaderMap), leaderRing);
+        EXPECT_GT((leader.usedCapacity() + 63) / 64, chunks);
+    }
+    followerThread.join();
+
+    EXPECT_EQ(leader.usedCapacity(), follower.usedCapacity());
+    EXPECT_EQ(leader.allocatedCount(), follower.allocatedCount());
+    EXPECT_EQ(0, memcmp(leader.begin(), follower.begin(), leader.usedCapacity() * leader.elementSize()));
+    EXPECT_EQ(0, memcmp(leaderStorage.get(), followerStorage.get(), sizeof(LeaderMap)));
+
+    ArenaConfig<FollowerArena>::setArena(&follower);
+    ArenaConfig<FollowerArena>::setContainer(followerStorage.get());
+    reinterpret_cast<FollowerMap*>(followerStorage.get())->~FollowerMap();
+    map->~LeaderMap();
+}
+
+TEST(ReplicationTest, corruptedDeltaIsSkipped) {
+    constexpr size_t ringCapacity = 1 << 20;
+    vector<uint64_t> ringMemory(SpscRing::requiredBytes(ringCapacity) / sizeof(uint64_t) + 1);
+    vector<uint64_t> scratchMemory(SpscRing::requiredBytes(ringCapacity) / sizeof(uint64_t) + 1);
+    SpscRing ring(ringMemory.data(), ringCapacity);
+    SpscRing scratch(scratchMemory.data(), ringCapacity);
+
+    LeaderArena leader(1000);
+    unique_ptr<MapStorage> leaderStorage(new MapStorage);
+    ArenaConfig<LeaderArena>::setArena(&leader);
+    ArenaConfig<LeaderArena>::setStackTop(getThreadStackTop());
+    ArenaConfig<LeaderArena>::setContainer(leaderStorage.get());
+    LeaderMap* map = ::new (leaderStorage.get()) LeaderMap();
+    for (int i = 0; i < 100; ++i) {
+        map->emplace(i, i);
+    }
+    FollowerArena follower;
+    unique_ptr<MapStorage> followerStorage(new MapStorage);
+    leader.markAllDirty();
+    replicateDelta(leader, map, sizeof(LeaderMap), ring);
+    ASSERT_TRUE(applyReplicatedDelta(follower, followerStorage.get(), sizeof(FollowerMap), ring));
+    size_t usedBytes = follower.usedCapacity() * follower.elementSize();
+    vector<char> before(follower.begin(), follower.begin() + usedBytes);
+
+    // a delta with a flipped byte in the last chunk
+    for (int i = 100; i < 200; ++i) {
+        map->emplace(i, i);
+    }
+    replicateDelta(leader, map, sizeof(LeaderMap), scratch);
+    uint64_t size;
+    scratch.read(&size, sizeof(size));
+    vector<char> delta(size);
+    scratch.read(delta.data(), delta.size());
+    delta[delta.size() - 12] ^= 1;
+    ring.write(&size, sizeof(size));
+    ring.write(delta.data(), delta.size());
+    EXPECT_THROW(applyReplicatedDelta(follower, followerStorage.get(), sizeof(FollowerMap), ring), std::runtime_error);
+    EXPECT_EQ(0u, ring.readable());
+    EXPECT_EQ(usedBytes, follower.usedCapacity() * follower.elementSize());
+    EXPECT_EQ(0, memcmp(before.data(), follower.begin(), usedBytes));
+
+    // resynchronized by the next full delta
+    leader.markAllDirty();
+    replicateDelta(leader, map, sizeof(LeaderMap), ring);
+    ASSERT_TRUE(applyReplicatedDelta(follower, followerStorage.get(), sizeof(FollowerMap), ring));
+    EXPECT_EQ(leader.usedCapacity(), follower.usedCapacity());
+    EXPECT_EQ(0, memcmp(leader.begin(), follower.begin(), leader.usedCapacity() * leader.elementSize()));
+    EXPECT_EQ(0, memcmp(leaderStorage.get(), followerStorage.get(), sizeof(LeaderMap)));
+    follower.discard();
+    map->~LeaderMap();
+}
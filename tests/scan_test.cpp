@@ -0,0 +1,132 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/ArenaScan.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = ArrayArena<uint32_t, NewAlloc>;
+using ArenaMT = ArrayArenaMT<uint32_t, NewAlloc>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigStatic<Arena, ArenaConfig> {};
+}
+
+using Map = boost::container::map<int, int, std::less<int>, Allocator<pair<const int, int>, ArenaConfig>>;
+
+class ArenaScanTest : public ::testing::Test {
+protected:
+    static constexpr int count = 20000;
+
+    Arena m_arena;
+
+    ArenaScanTest()
+    : m_arena(count) {
+        ArenaConfig::setArena(&m_arena);
+        ArenaConfig::setStackTop(getThreadStackTop());
+    }
+
+    // every element of the map, modified in place
+    static void checkScan(Map& map, const Arena& arena, unsigned threads) {
+        atomic<int64_t> sum(0);
+        atomic<int> visited(0);
+        forEachElement(map, arena, [&](pair<const int, int>& element) {
+            sum += element.first;
+            ++visited;
+            element.second = -element.first;
+        }, threads);
+        int64_t expected = 0;
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            expected += (*it).first;
+            EXPECT_EQ(-(*it).first, (*it).second);
+        }
+        EXPECT_EQ(int(map.size()), visited.load());
+        EXPECT_EQ(expected, sum.load());
+    }
+};
+
+constexpr int ArenaScanTest::count;
+
+TEST_F(ArenaScanTest, skipsFreeSlots) {
+    Map map;
+    for (int i = 0; i < count; ++i) {
+        map.emplace(i, 0);
+    }
+    for (int i = 0; i < count; i += 3) {
+        map.erase(i);
+    }
+    checkScan(map, m_arena, 1);
+    checkScan(map, m_arena, 4);
+
+    vector<uint32_t> indices;
+    forEachLive(m_arena, [&indices](uint32_t index, void*) {
+        indices.push_back(index);
+    });
+    ASSERT_EQ(map.size(), indices.size());
+    EXPECT_TRUE(is_sorted(indices.begin(), indices.end()));
+
+    Map empty;
+    checkScan(empty, m_arena, 1);
+}
+
+TEST_F(ArenaScanTest, deletionOff) {
+    m_arena.enableDelete(false);
+    Map map;
+    for (int i = 0; i < 100; ++i) {
+        map.emplace(i, 0);
+    }
+    checkScan(map, m_arena, 1);
+    map.erase(5);
+    EXPECT_THROW(checkScan(map, m_arena, 1), std::logic_error);
+}
+
+TEST(ArenaScanMTTest, liveObjects) {
+    constexpr size_t elementSize = 8;
+    ArenaMT arena(10000);
+    for (uint64_t i = 1; i <= 10000; ++i) {
+        uint32_t index = arena.allocate(elementSize);
+        *static_cast<uint64_t*>(arena.getElement(index)) = i;
+    }
+    for (uint32_t index = 2; index <= 10000; index += 2) {
+        arena.deallocate(index, elementSize);
+    }
+    atomic<uint64_t> sum(0);
+    forEachLive(arena, [&sum](uint32_t index, void* object) {
+        EXPECT_EQ(1u, index % 2);
+        sum += *static_cast<uint64_t*>(object);
+    }, 3);
+    EXPECT_EQ(5000u * 5000u, sum.load());
+    for (uint32_t index = 1; index <= 10000; index += 2) {
+        arena.deallocate(index, elementSize);
+    }
+}
+
+TEST(ArenaScanMTTest, deletionOff) {
+    constexpr size_t elementSize = 8;
+    ArenaMT arena(100);
+    arena.enableDelete(false);
+    forEachLive(arena, [](uint32_t, void*) { ADD_FAILURE(); });
+    uint32_t index = arena.allocate(elementSize);
+    arena.allocate(elementSize);
+    arena.deallocate(index, elementSize);
+    EXPECT_THROW(forEachLive(arena, [](uint32_t, void*) {}), std::logic_error);
+    arena.discard();
+}
@@ -0,0 +1,154 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ShmArenaMT.h>
+#include <indexed/ConfigArenaPtr.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/list.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <new>
+#include <numeric>
+#include <string>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = ShmArenaMT<uint32_t>;
+
+namespace bip = boost::interprocess;
+
+namespace {
+    // The list object lives in Arena::root(), every process sets its own Arena and root into the config.
+    struct ArenaConfig : public SingleArenaConfigUniversalStatic<Arena, ArenaConfig, Arena::kDefaultRootSize> {
+        static constexpr bool kAssignContainerFollowingAllocator = false;
+
+        // the Allocator inside the shared list must not keep the Arena address of one process
+        using ArenaPtr = ConfigArenaPtr<ArenaConfig>;
+
+        static ArenaPtr defaultArena() noexcept { return ArenaPtr(); }
+    };
+}
+
+using Value = int;
+using Alloc = Allocator<Value, ArenaConfig>;
+using List = boost::container::list<Value, Alloc>;
+
+static_assert(sizeof(List) <= Arena::kDefaultRootSize, "List doesn't fit root");
+
+class ShmArenaTest : public ::testing::Test {
+protected:
+    static constexpr size_t capacity = 1000;
+    static constexpr size_t elementSize = 16;
+
+    string m_name;
+
+    ShmArenaTest()
+    : m_name("indexed_shm_test_" + to_string(getpid())) {
+        Arena::remove(m_name.c_str());
+    }
+
+    ~ShmArenaTest() { Arena::remove(m_name.c_str()); }
+
+    static void attach(Arena& arena) {
+        ArenaConfig::setArena(&arena);
+        ArenaConfig::setStackTop(getThreadStackTop());
+        ArenaConfig::setContainer(arena.root());
+    }
+};
+
+constexpr size_t ShmArenaTest::capacity;
+constexpr size_t ShmArenaTest::elementSize;
+
+TEST_F(ShmArenaTest, allocateAndAttach) {
+    Arena arena(bip::create_only, m_name.c_str(), capacity, elementSize);
+    EXPECT_EQ(capacity, arena.capacity());
+    EXPECT_EQ(elementSize, arena.elementSize());
+    uint32_t first = arena.allocate(elementSize);
+    uint32_t second = arena.allocate(8);
+    EXPECT_EQ(1u, first);
+    EXPECT_EQ(2u, second);
+    *static_cast<int*>(arena.getElement(second)) = 42;
+
+    Arena other(bip::open_only, m_name.c_str());
+    EXPECT_NE(arena.begin(), other.begin());
+    EXPECT_EQ(capacity, other.capacity());
+    EXPECT_EQ(elementSize, other.elementSize());
+    EXPECT_EQ(2u, other.usedCapacity());
+    EXPECT_EQ(42, *static_cast<int*>(other.getElement(second)));
+    EXPECT_EQ(second, other.pointer_to(other.getElement(second)));
+
+    // the free list is shared
+    arena.deallocate(first, elementSize);
+    EXPECT_EQ(first, other.allocate(elementSize));
+    other.deallocate(first, elementSize);
+    other.deallocate(second, elementSize);
+    EXPECT_EQ(second, arena.allocate(elementSize));
+}
+
+TEST_F(ShmArenaTest, exhaustAndOpenErrors) {
+    Arena arena(bip::create_only, m_name.c_str(), 2, elementSize);
+    arena.allocate(elementSize);
+    arena.allocate(elementSize);
+    EXPECT_EQ(0u, arena.tryAllocate(elementSize));
+    EXPECT_THROW(arena.allocate(elementSize), std::bad_alloc);
+    arena.reset();
+    EXPECT_EQ(0u, arena.usedCapacity());
+
+    EXPECT_THROW(Arena(bip::create_only, m_name.c_str(), 2, elementSize), bip::interprocess_exception);
+    EXPECT_THROW(Arena(bip::open_or_create, m_name.c_str(), 3, elementSize), std::runtime_error);
+    EXPECT_THROW(ShmArenaMT<uint16_t>(bip::open_only, m_name.c_str()), std::runtime_error);
+    Arena same(bip::open_or_create, m_name.c_str(), 2, elementSize);
+    EXPECT_EQ(2u, same.capacity());
+    EXPECT_THROW(Arena(bip::open_only, "indexed_shm_test_missing"), bip::interprocess_exception);
+}
+
+TEST_F(ShmArenaTest, listSharedWithChildProcess) {
+    Arena arena(bip::create_only, m_name.c_str(), capacity, elementSize);
+    attach(arena);
+    List* list = ::new (arena.root()) List();
+    for (int i = 1; i <= 100; ++i) {
+        list->push_back(i);
+    }
+
+    pid_t child = fork();
+    ASSERT_NE(-1, child);
+    if (child == 0) {
+        int res = 1;
+        try {
+            // new mapping at another address, the indices stay valid
+            Arena childArena(bip::open_only, m_name.c_str());
+            attach(childArena);
+            List& childList = *static_cast<List*>(childArena.root());
+            if (childArena.begin() != arena.begin() && childList.size() == 100
+                && accumulate(childList.begin(), childList.end(), 0) == 5050) {
+                childList.pop_front();
+                childList.push_back(1000);
+                res = 0;
+            }
+        } catch (...) {}
+        _exit(res);
+    }
+    int status = 0;
+    ASSERT_EQ(child, waitpid(child, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+
+    EXPECT_EQ(100u, list->size());
+    EXPECT_EQ(2, list->front());
+    EXPECT_EQ(1000, list->back());
+    EXPECT_EQ(5050 - 1 + 1000, accumulate(list->begin(), list->end(), 0));
+    list->~List();
+}
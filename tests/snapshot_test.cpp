@@ -0,0 +1,332 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/ArenaSnapshot.h>
+#include <indexed/ArenaClone.h>
+#include <indexed/ForkSnapshot.h>
+#include <indexed/ConfigArenaPtr.h>
+#include <indexed/SingleArenaConfigUniversal.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = ArrayArena<uint32_t, NewAlloc>;
+using ArenaMT = ArrayArenaMT<uint32_t, NewAlloc>;
+using Arena16 = ArrayArena<uint16_t, NewAlloc>;
+
+namespace {
+    // The map is copied as bytes, its Allocator must not keep the Arena address
+    struct ArenaConfig : public SingleArenaConfigUniversalStatic<Arena, ArenaConfig> {
+        static constexpr bool kAssignContainerFollowingAllocator = false;
+
+        using ArenaPtr = ConfigArenaPtr<ArenaConfig>;
+
+        static ArenaPtr defaultArena() noexcept { return ArenaPtr(); }
+    };
+}
+
+using Key = int;
+using Value = int;
+using Pair = pair<const Key, Value>;
+using Alloc = Allocator<Pair, ArenaConfig>;
+using Map = boost::container::map<Key, Value, std::less<Key>, Alloc>;
+
+class SnapshotTest : public ::testing::Test {
+protected:
+    static constexpr size_t capacity = 1000;
+
+    using MapStorage = aligned_storage<sizeof(Map), alignof(Map)>::type;
+
+    Arena m_arena;
+    MapStorage m_storage;
+    Map* m_map;
+
+    SnapshotTest()
+    : m_arena(capacity) {
+        use(m_arena, &m_storage);
+        m_map = ::new (&m_storage) Map();
+        for (int i = 0; i < 300; ++i) {
+            m_map->emplace(i, -i);
+        }
+        for (int i = 0; i < 300; i += 3) {
+            m_map->erase(i);
+        }
+    }
+
+    ~SnapshotTest() {
+        use(m_arena, &m_storage);
+        m_map->~Map();
+    }
+
+    static void use(Arena& arena, void* container) {
+        ArenaConfig::setArena(&arena);
+        ArenaConfig::setStackTop(getThreadStackTop());
+        ArenaConfig::setContainer(container);
+    }
+
+    static void checkLoaded(Arena& arena, MapStorage& storage) {
+        use(arena, &storage);
+        Map& map = *reinterpret_cast<Map*>(&storage);
+        EXPECT_EQ(200u, map.size());
+        for (int i = 0; i < 300; ++i) {
+            auto it = map.find(i);
+            if (i % 3 == 0) {
+                EXPECT_TRUE(it == map.end());
+            } else {
+                ASSERT_TRUE(it != map.end());
+                EXPECT_EQ(-i, (*it).second);
+            }
+        }
+        // the free list is restored, erased slots are reused
+        size_t used = arena.usedCapacity();
+        for (int i = 0; i < 300; i += 3) {
+            map.emplace(i, -i);
+        }
+        EXPECT_EQ(used, arena.usedCapacity());
+        EXPECT_EQ(300u, map.size());
+        map.~Map();
+    }
+};
+
+constexpr size_t SnapshotTest::capacity;
+
+TEST_F(SnapshotTest, bufferRoundTrip) {
+    vector<char> buf(snapshotSize(m_arena, sizeof(Map)));
+    EXPECT_EQ(buf.size(), saveSnapshot(m_arena, m_map, sizeof(Map), buf.data(), buf.size()));
+    ArenaSnapshotHeader header;
+    memcpy(&header, buf.data(), sizeof(header));
+    EXPECT_EQ(0u, header.dataOffset % ArenaSnapshotHeader::kDataAlignment);
+    EXPECT_LE(sizeof(header) + sizeof(Map), header.dataOffset);
+    EXPECT_EQ(buf.size(), header.dataOffset + header.dataSize);
+    EXPECT_THROW(saveSnapshot(m_arena, m_map, sizeof(Map), buf.data(), buf.size() - 1), std::length_error);
+
+    Arena loaded;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    loadSnapshot(loaded, &storage, sizeof(Map), buf.data(), buf.size());
+    EXPECT_EQ(capacity, loaded.capacity());
+    EXPECT_EQ(m_arena.usedCapacity(), loaded.usedCapacity());
+    EXPECT_EQ(m_arena.allocatedCount(), loaded.allocatedCount());
+    checkLoaded(loaded, storage);
+}
+
+TEST_F(SnapshotTest, corruptedBuffer) {
+    vector<char> buf(snapshotSize(m_arena, sizeof(Map)));
+    saveSnapshot(m_arena, m_map, sizeof(Map), buf.data(), buf.size());
+    Arena loaded;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    EXPECT_THROW(loadSnapshot(loaded, &storage, sizeof(Map) + 8, buf.data(), buf.size()), std::runtime_error);
+    EXPECT_THROW(loadSnapshot(loaded, &storage, sizeof(Map), buf.data(), buf.size() - 1), std::runtime_error);
+    buf[buf.size() / 2] ^= 1;
+    EXPECT_THROW(loadSnapshot(loaded, &storage, sizeof(Map), buf.data(), buf.size()), std::runtime_error);
+    ArenaSnapshotHeader header;
+    memcpy(&header, buf.data(), sizeof(header));
+    header.arena.usedCapacity = header.arena.capacity = UINT64_MAX / header.arena.elementSize;
+    header.dataSize = header.arena.usedCapacity * header.arena.elementSize;
+    header.checksum = 0; // the header checks run before the checksum, they must catch it
+    memcpy(buf.data(), &header, sizeof(header));
+    EXPECT_THROW(loadSnapshot(loaded, &storage, sizeof(Map), buf.data(), buf.size()), std::runtime_error);
+    // the objects must start at the aligned offset
+    memcpy(&header, buf.data(), sizeof(header));
+    header.dataOffset += 8;
+    memcpy(buf.data(), &header, sizeof(header));
+    EXPECT_THROW(loadSnapshot(loaded, &storage, sizeof(Map), buf.data(), buf.size()), std::runtime_error);
+    buf[0] = 'X';
+    EXPECT_THROW(loadSnapshot(loaded, &storage, sizeof(Map), buf.data(), buf.size()), std::runtime_error);
+    EXPECT_EQ(nullptr, loaded.begin());
+}
+
+TEST_F(SnapshotTest, fileRoundTrip) {
+    FILE* file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    int fd = fileno(file);
+    saveSnapshot(m_arena, m_map, sizeof(Map), fd);
+
+    Arena loaded;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    ASSERT_EQ(0, lseek(fd, 0, SEEK_SET));
+    loadSnapshot(loaded, &storage, sizeof(Map), fd);
+    checkLoaded(loaded, storage);
+
+    // truncated file
+    ASSERT_EQ(0, ftruncate(fd, off_t(snapshotSize(m_arena, sizeof(Map)) - 1)));
+    ASSERT_EQ(0, lseek(fd, 0, SEEK_SET));
+    Arena truncated;
+    EXPECT_THROW(loadSnapshot(truncated, &storage, sizeof(Map), fd), std::runtime_error);
+    EXPECT_EQ(nullptr, truncated.begin());
+    fclose(file);
+}
+
+TEST_F(SnapshotTest, cloneMap) {
+    Arena cloned;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    cloneInto(m_arena, m_map, sizeof(Map), cloned, &storage);
+    EXPECT_EQ(capacity, cloned.capacity());
+    EXPECT_EQ(m_arena.usedCapacity(), cloned.usedCapacity());
+    EXPECT_EQ(m_arena.allocatedCount(), cloned.allocatedCount());
+    EXPECT_EQ(0, memcmp(m_arena.begin(), cloned.begin(), m_arena.usedCapacity() * m_arena.elementSize()));
+    checkLoaded(cloned, storage);
+
+    // the source isn't affected by the clone modifications
+    use(m_arena, &m_storage);
+    EXPECT_EQ(200u, m_map->size());
+    EXPECT_TRUE(m_map->find(3) == m_map->end());
+
+    // a target with a buffer must match
+    Arena other(capacity + 1);
+    other.allocate(m_arena.elementSize());
+    EXPECT_THROW(cloneInto(m_arena, other), std::runtime_error);
+    other.deallocate(1, m_arena.elementSize());
+}
+
+TEST(ArenaCloneTest, parallelCopy) {
+    // a few MBs, so several threads take a part
+    constexpr size_t capacity = 1 << 20;
+    constexpr size_t elementSize = 8;
+    ArenaMT arena(capacity);
+    for (size_t i = 0; i < capacity / 2; ++i) {
+        uint32_t index = arena.allocate(elementSize);
+        *static_cast<uint64_t*>(arena.getElement(index)) = i * 7;
+    }
+    for (uint32_t index = 1; index < capacity / 2; index += 5) {
+        arena.deallocate(index, elementSize);
+    }
+    ArenaMT cloned;
+    cloneInto(arena, cloned, 4);
+    EXPECT_EQ(arena.usedCapacity(), cloned.usedCapacity());
+    EXPECT_EQ(arena.metadata().freeListHead, cloned.metadata().freeListHead);
+    EXPECT_EQ(0, memcmp(arena.begin(), cloned.begin(), arena.usedCapacity() * elementSize));
+    // the free list is cloned
+    uint32_t reused = arena.allocate(elementSize);
+    EXPECT_EQ(reused, cloned.allocate(elementSize));
+    for (uint32_t index = 1; index <= capacity / 2; ++index) {
+        if (index % 5 != 1 || index == reused) {
+            arena.deallocate(index, elementSize);
+            cloned.deallocate(index, elementSize);
+        }
+    }
+}
+
+TEST_F(SnapshotTest, forkSnapshotIsFrozen) {
+    int pipeFds[2];
+    ASSERT_EQ(0, pipe(pipeFds));
+    ForkSnapshot snapshot([&]() {
+        char go;
+        if (read(pipeFds[0], &go, 1) != 1) {
+            return 2;
+        }
+        // the parent has modified the map meanwhile
+        if (m_map->size() != 200 || m_map->find(1000) != m_map->end()) {
+            return 3;
+        }
+        for (int i = 1; i < 300; i += 3) {
+            if ((*m_map->find(i)).second != -i) {
+                return 4;
+            }
+        }
+        return 0;
+    });
+    for (int i = 1; i < 300; i += 3) {
+        (*m_map->find(i)).second = 0;
+    }
+    m_map->emplace(1000, 0);
+    ASSERT_EQ(1, write(pipeFds[1], "x", 1));
+    EXPECT_EQ(0, snapshot.wait());
+    EXPECT_TRUE(snapshot.finished());
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+}
+
+TEST_F(SnapshotTest, forkSnapshotCheckpoint) {
+    FILE* file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    int fd = fileno(file);
+    {
+        ForkSnapshot checkpoint([&]() {
+            saveSnapshot(m_arena, m_map, sizeof(Map), fd);
+            return 0;
+        });
+        m_map->clear();
+        EXPECT_EQ(0, checkpoint.wait());
+    }
+    Arena loaded;
+    unique_ptr<MapStorage> storageOnHeap(new MapStorage); // not on stack, see saveSnapshot()
+    MapStorage& storage = *storageOnHeap;
+    ASSERT_EQ(0, lseek(fd, 0, SEEK_SET));
+    loadSnapshot(loaded, &storage, sizeof(Map), fd);
+    checkLoaded(loaded, storage);
+    fclose(file);
+}
+
+TEST(ArenaMetadataTest, restoreArrayArenaMT) {
+    constexpr size_t elementSize = 8;
+    ArenaMT arena(10);
+    for (uint32_t i = 1; i <= 5; ++i) {
+        EXPECT_EQ(i, arena.allocate(elementSize));
+    }
+    arena.deallocate(2, elementSize);
+    arena.deallocate(4, elementSize);
+    ArenaMetadata meta = arena.metadata();
+    EXPECT_EQ(10u, meta.capacity);
+    EXPECT_EQ(elementSize, meta.elementSize);
+    EXPECT_EQ(5u, meta.usedCapacity);
+    EXPECT_EQ(3u, meta.allocatedCount);
+    EXPECT_EQ(4u, meta.freeListHead);
+
+    ArenaMT restored;
+    restored.restore(meta);
+    memcpy(restored.begin(), arena.begin(), meta.usedCapacity * meta.elementSize);
+    ArenaMetadata bigger = meta;
+    bigger.capacity = 20;
+    EXPECT_THROW(restored.restore(bigger), std::runtime_error);
+    EXPECT_EQ(4u, restored.allocate(elementSize));
+    EXPECT_EQ(2u, restored.allocate(elementSize));
+    EXPECT_EQ(6u, restored.allocate(elementSize));
+
+    // the same state fits ArrayArena
+    Arena plain;
+    plain.restore(meta);
+    memcpy(plain.begin(), arena.begin(), meta.usedCapacity * meta.elementSize);
+    EXPECT_EQ(3u, plain.allocatedCount());
+    EXPECT_EQ(4u, plain.allocate(elementSize));
+
+    meta.indexSize = 2;
+    EXPECT_THROW(Arena16().restore(arena.metadata()), std::invalid_argument);
+    EXPECT_THROW(ArenaMT().restore(meta), std::invalid_argument);
+
+    restored.deallocate(4, elementSize); // leave no objects for the debug checks
+    restored.deallocate(2, elementSize);
+    restored.deallocate(6, elementSize);
+    for (uint32_t index : {1, 3, 5}) {
+        restored.deallocate(index, elementSize);
+        arena.deallocate(index, elementSize);
+    }
+    plain.deallocate(4, elementSize);
+    for (uint32_t index : {1, 3, 5}) {
+        plain.deallocate(index, elementSize);
+    }
+}
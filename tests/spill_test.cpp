@@ -0,0 +1,160 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/SpillArena.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/MmapAlloc.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/list.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = SpillArena<ArrayArena<uint16_t, NewAlloc>, ArrayArena<uint16_t, MmapAlloc>>;
+using ArenaMT = SpillArena<ArrayArenaMT<uint32_t, NewAlloc>>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigStatic<Arena, ArenaConfig> {};
+}
+
+TEST(SpillArenaTest, tryAllocateDoesntThrow) {
+    ArrayArena<uint32_t, NewAlloc> arena(1);
+    uint32_t index = arena.tryAllocate(8);
+    EXPECT_NE(index, 0u);
+    EXPECT_EQ(arena.tryAllocate(8), 0u);
+    EXPECT_EQ(arena.allocatedCount(), 1u);
+    arena.deallocate(index, 8);
+
+    ArrayArenaMT<uint32_t, NewAlloc> arenaMT(1);
+    index = arenaMT.tryAllocate(8);
+    EXPECT_NE(index, 0u);
+    EXPECT_EQ(arenaMT.tryAllocate(8), 0u);
+    EXPECT_EQ(arenaMT.usedCapacity(), 1u);
+    arenaMT.deallocate(index, 8);
+    arenaMT.reset();
+}
+
+TEST(SpillArenaTest, spillsToSecondary) {
+    Arena arena(4, 100);
+    size_t soft = 0;
+    size_t hard = 0;
+    arena.setSoftWatermark(3, [&soft] { ++soft; });
+    arena.setHardWatermark([&hard] { ++hard; });
+    ArenaConfig::setArena(&arena);
+    ArenaConfig::setStackTop(getThreadStackTop());
+    {
+        boost::container::list<int, Allocator<int, ArenaConfig>> list;
+        for (int i = 0; i < 50; ++i) {
+            list.push_back(i);
+        }
+        EXPECT_EQ(soft, 1u);
+        EXPECT_EQ(hard, 1u);
+        EXPECT_EQ(arena.primary().usedCapacity(), 4u);
+        EXPECT_EQ(arena.spilledCapacity(), 46u);
+        int expected = 0;
+        for (int val : list) {
+            EXPECT_EQ(val, expected++);
+        }
+        while (list.size() > 2) {
+            list.pop_back();
+        }
+        EXPECT_EQ(arena.spilledCapacity(), 0u);
+        for (int i = 0; i < 10; ++i) {
+            list.push_back(i);
+        }
+        EXPECT_EQ(soft, 1u);
+        EXPECT_EQ(hard, 1u);
+        arena.rearmWatermarks();
+        list.push_back(0);
+        EXPECT_EQ(hard, 2u);
+    }
+    EXPECT_EQ(arena.usedCapacity(), 0u);
+}
+
+TEST(SpillArenaTest, softWatermarkIsUsedCapacity) {
+    Arena arena(4, 4);
+    size_t soft = 0;
+    arena.setSoftWatermark(3, [&soft] { ++soft; });
+    uint16_t a = arena.allocate(8);
+    uint16_t b = arena.allocate(8);
+    uint16_t c = arena.allocate(8);
+    EXPECT_EQ(soft, 1u);
+    uint16_t d = arena.allocate(8);
+    EXPECT_EQ(soft, 1u);
+    // the rearmed callback fires on the next allocation, the reused slot isn't the watermark index
+    arena.deallocate(b, 8);
+    arena.rearmWatermarks();
+    b = arena.allocate(8);
+    EXPECT_EQ(b, 2u);
+    EXPECT_EQ(soft, 2u);
+    arena.deallocate(a, 8);
+    arena.deallocate(b, 8);
+    arena.deallocate(c, 8);
+    arena.deallocate(d, 8);
+}
+
+TEST(SpillArenaTest, throwsWhenBothAreFull) {
+    Arena arena(1, 1);
+    uint16_t a = arena.allocate(8);
+    uint16_t b = arena.allocate(8);
+    EXPECT_EQ(a, 1u);
+    EXPECT_EQ(b, 2u);
+    EXPECT_EQ(arena.pointer_to(arena.getElement(b)), b);
+    EXPECT_EQ(arena.tryAllocate(8), 0u);
+    EXPECT_THROW(arena.allocate(8), bad_alloc);
+    arena.deallocate(a, 8);
+    arena.deallocate(b, 8);
+    EXPECT_THROW(Arena(1u << 14, 1u << 14), length_error);
+}
+
+TEST(SpillArenaTest, spillsMT) {
+    constexpr size_t kThreads = 4;
+    constexpr size_t kLive = 16;
+    ArenaMT arena(kThreads * kLive / 2, kThreads * kLive);
+    atomic<size_t> hard(0);
+    atomic<size_t> ready(0);
+    arena.setHardWatermark([&hard] { ++hard; });
+    vector<thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&arena, &ready, t] {
+            vector<uint32_t> live;
+            for (size_t k = 0; k < kLive; ++k) {
+                uint32_t index = arena.allocate(8);
+                *static_cast<uint32_t*>(arena.getElement(index)) = uint32_t(t);
+                live.push_back(index);
+            }
+            // all objects are alive at once, so some of them are in the secondary Arena
+            ++ready;
+            while (ready != kThreads) {
+                this_thread::yield();
+            }
+            for (uint32_t index : live) {
+                EXPECT_EQ(*static_cast<uint32_t*>(arena.getElement(index)), t);
+                arena.deallocate(index, 8);
+            }
+        });
+    }
+    for (thread& th : threads) {
+        th.join();
+    }
+    EXPECT_EQ(arena.primary().usedCapacity(), kThreads * kLive / 2);
+    EXPECT_EQ(arena.spilledCapacity(), kThreads * kLive / 2);
+    EXPECT_EQ(hard.load(), 1u);
+    arena.reset();
+}
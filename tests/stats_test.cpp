@@ -0,0 +1,129 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/StatsArena.h>
+#include <indexed/NewAlloc.h>
+#include <indexed/SingleArenaConfig.h>
+#include <indexed/Allocator.h>
+#include <indexed/StackTop.h>
+
+#include <boost/container/list.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+using Arena = StatsArena<ArrayArena<uint32_t, NewAlloc>>;
+using ArenaMT = StatsArena<ArrayArenaMT<uint32_t, NewAlloc>>;
+
+namespace {
+    struct ArenaConfig : public SingleArenaConfigStatic<Arena, ArenaConfig> {};
+}
+
+TEST(StatsArenaTest, countsAllocations) {
+    Arena arena(10);
+    EXPECT_EQ(arena.stats().bytesCommitted, 0u);
+    uint32_t a = arena.allocate(8);
+    uint32_t b = arena.allocate(8);
+    uint32_t c = arena.allocate(8);
+    arena.deallocate(b, 8);
+    ArenaStats stats = arena.stats();
+    EXPECT_EQ(stats.allocations, 3u);
+    EXPECT_EQ(stats.deallocations, 1u);
+    EXPECT_EQ(stats.liveObjects, 2u);
+    EXPECT_EQ(stats.liveObjects, arena.allocatedCount());
+    EXPECT_EQ(stats.highWaterMark, 3u);
+    EXPECT_EQ(stats.usedCapacity, 3u);
+    EXPECT_EQ(stats.freeListLength, 1u);
+    EXPECT_EQ(stats.elementSize, 8u);
+    EXPECT_EQ(stats.bytesCommitted, 80u);
+    EXPECT_EQ(stats.bytesLive, 16u);
+    EXPECT_DOUBLE_EQ(stats.fragmentation, 1.0 / 3);
+    arena.deallocate(a, 8);
+    arena.deallocate(c, 8);
+    stats = arena.stats();
+    EXPECT_EQ(stats.liveObjects, 0u);
+    EXPECT_EQ(stats.usedCapacity, 0u);
+    EXPECT_EQ(stats.highWaterMark, 3u);
+    EXPECT_DOUBLE_EQ(stats.fragmentation, 0.0);
+    arena.clearStats();
+    EXPECT_EQ(arena.stats().allocations, 0u);
+    EXPECT_EQ(arena.stats().highWaterMark, 0u);
+}
+
+TEST(StatsArenaTest, countsBadAlloc) {
+    Arena arena(2);
+    uint32_t a = arena.allocate(8);
+    uint32_t b = arena.allocate(8);
+    EXPECT_THROW(arena.allocate(8), bad_alloc);
+    EXPECT_THROW(arena.allocate(8), bad_alloc);
+    ArenaStats stats = arena.stats();
+    EXPECT_EQ(stats.badAllocCount, 2u);
+    EXPECT_EQ(stats.allocations, 2u);
+    arena.deallocate(a, 8);
+    arena.deallocate(b, 8);
+}
+
+TEST(StatsArenaTest, worksAsConfigArena) {
+    Arena arena(100);
+    ArenaConfig::setArena(&arena);
+    ArenaConfig::setStackTop(getThreadStackTop());
+    {
+        boost::container::list<int, Allocator<int, ArenaConfig>> list;
+        for (int i = 0; i < 10; ++i) {
+            list.push_back(i);
+        }
+        list.pop_front();
+        EXPECT_EQ(arena.stats().liveObjects, 9u);
+        EXPECT_EQ(arena.stats().highWaterMark, 10u);
+    }
+    EXPECT_EQ(arena.stats().allocations, 10u);
+    EXPECT_EQ(arena.stats().deallocations, 10u);
+}
+
+TEST(StatsArenaTest, shardedCountersMT) {
+    constexpr size_t kThreads = 4;
+    constexpr size_t kOps = 10000;
+    constexpr size_t kLive = 20;
+    ArenaMT arena(kThreads * kLive);
+    vector<thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&arena] {
+            vector<uint32_t> live;
+            for (size_t k = 0; k < kOps; ++k) {
+                if (live.size() < kLive) {
+                    live.push_back(arena.allocate(8));
+                } else {
+                    arena.deallocate(live[k % kLive], 8);
+                    live[k % kLive] = arena.allocate(8);
+                }
+            }
+            for (uint32_t index : live) {
+                arena.deallocate(index, 8);
+            }
+        });
+    }
+    for (thread& th : threads) {
+        th.join();
+    }
+    ArenaStats stats = arena.stats();
+    EXPECT_EQ(stats.allocations, stats.deallocations);
+    EXPECT_EQ(stats.liveObjects, 0u);
+    EXPECT_EQ(stats.badAllocCount, 0u);
+    EXPECT_LE(stats.highWaterMark, kThreads * kLive);
+    EXPECT_EQ(stats.highWaterMark, arena.usedCapacity());
+    EXPECT_EQ(stats.freeListLength, stats.usedCapacity);
+    EXPECT_DOUBLE_EQ(stats.fragmentation, 1.0);
+    arena.reset();
+}
@@ -0,0 +1,91 @@
+
+//          Copyright Alexander Bulovyatov 2018.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file ../LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstddef>
+
+// The tracepoints are enabled in this translation unit only, it's safe since the Arenas here
+// use TraceAlloc, so their code isn't shared with the other tests.
+namespace {
+    void recordEvent(const char* event, const void* arena, size_t arg1, size_t arg2);
+}
+
+#define INDEXED_TRACE 2
+#define INDEXED_TRACE_HOOK(event, arena, arg1, arg2) recordEvent(event, arena, arg1, arg2)
+
+#include <indexed/ArrayArena.h>
+#include <indexed/ArrayArenaMT.h>
+#include <indexed/NewAlloc.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace indexed;
+using namespace std;
+
+namespace {
+    struct Event {
+        string name;
+        const void* arena;
+        size_t arg1;
+        size_t arg2;
+    };
+
+    vector<Event> events;
+
+    void recordEvent(const char* event, const void* arena, size_t arg1, size_t arg2) {
+        events.push_back(Event{event, arena, arg1, arg2});
+    }
+
+    struct TraceAlloc : public NewAlloc {};
+}
+
+template <typename Arena>
+class TraceTest : public ::testing::Test {
+protected:
+    TraceTest() { events.clear(); }
+
+    static void expectEvent(size_t pos, const string& name, const void* arena, size_t arg1, size_t arg2) {
+        ASSERT_LT(pos, events.size());
+        EXPECT_EQ(events[pos].name, name);
+        EXPECT_EQ(events[pos].arena, arena);
+        EXPECT_EQ(events[pos].arg1, arg1);
+        EXPECT_EQ(events[pos].arg2, arg2);
+    }
+};
+
+using Arenas = ::testing::Types<ArrayArena<uint32_t, TraceAlloc>, ArrayArenaMT<uint32_t, TraceAlloc>>;
+TYPED_TEST_CASE(TraceTest, Arenas);
+
+TYPED_TEST(TraceTest, tracesArenaEvents) {
+    TypeParam arena(2);
+    uint32_t a = arena.allocate(8);
+    uint32_t b = arena.allocate(8);
+    EXPECT_THROW(arena.allocate(8), bad_alloc);
+    arena.deallocate(b, 8);
+    arena.deallocate(a, 8);
+    arena.reset();
+    arena.freeMemory();
+    // ArrayArena resets itself on the last deallocate
+    bool autoReset = !TypeParam::kIsArrayArenaMT;
+    ASSERT_EQ(events.size(), autoReset ? 10u : 9u);
+    this->expectEvent(0, "buffer_alloc", &arena, 2, 16);
+    this->expectEvent(1, "allocate", &arena, 1, 8);
+    this->expectEvent(2, "allocate", &arena, 2, 8);
+    this->expectEvent(3, "exhausted", &arena, 2, 8);
+    this->expectEvent(4, "deallocate", &arena, 2, 8);
+    this->expectEvent(5, "deallocate", &arena, 1, 8);
+    size_t pos = 6;
+    if (autoReset) {
+        this->expectEvent(pos++, "reset", &arena, 2, 0);
+    }
+    EXPECT_EQ(events[pos++].name, "reset");
+    this->expectEvent(pos++, "free_memory", &arena, 2, 8);
+    EXPECT_EQ(events[pos].name, "reset");
+}